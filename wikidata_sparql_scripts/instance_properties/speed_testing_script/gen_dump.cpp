@@ -0,0 +1,206 @@
+// Synthesizes Wikidata-shaped dumps for benchmarking the splitter on boxes
+// that don't hold the real 40 GB extracted_data.json. Output is the wrapped
+// format the splitter expects ({\n "Qn": {...},\n ...\n}), fully determined
+// by the seed: same flags, same bytes, so a perf regression reproduced here
+// reproduces everywhere. Values are copied out of a pre-randomized pool in
+// bulk, so generation runs at memory-copy speed rather than rand()-per-byte.
+//
+// Usage: gen_dump [--bytes SIZE | --entries N] [--seed S]
+//                 [--avg-entry BYTES] [--depth D] [--escape-pct P]
+//                 [--string-ratio R] [output.json]
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+// splitmix64: tiny, seedable, and good enough for shaping test data.
+struct Rng {
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [0, n).
+    uint64_t below(uint64_t n) { return next() % n; }
+};
+
+// K/M/G suffixes, same convention as split_json --target-batch-bytes.
+static long long parse_size(const char* s) {
+    char* end = nullptr;
+    long long v = strtoll(s, &end, 10);
+    if (v <= 0) return -1;
+    if (*end == 'k' || *end == 'K') v *= 1024;
+    else if (*end == 'm' || *end == 'M') v *= 1024 * 1024;
+    else if (*end == 'g' || *end == 'G') v *= 1024 * 1024 * 1024;
+    else if (*end != '\0') return -1;
+    return v;
+}
+
+int main(int argc, char** argv) {
+    long long target_bytes = 0;    // 0 = use --entries
+    long long target_entries = 10000;
+    uint64_t seed = 42;
+    long long avg_entry = 2800;    // matches the real dump's mean
+    int max_depth = 3;
+    int escape_pct = 2;            // % of string characters that are escapes
+    double string_ratio = 0.6;     // value bytes vs structural/key bytes
+    const char* output = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc) {
+            target_bytes = parse_size(argv[++i]);
+            if (target_bytes < 1024) {
+                std::cerr << "Bad --bytes (min 1K)" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--entries") == 0 && i + 1 < argc) {
+            target_entries = atoll(argv[++i]);
+            if (target_entries < 1) {
+                std::cerr << "Bad --entries" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--avg-entry") == 0 && i + 1 < argc) {
+            avg_entry = parse_size(argv[++i]);
+            if (avg_entry < 32) {
+                std::cerr << "Bad --avg-entry (min 32)" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            max_depth = atoi(argv[++i]);
+            if (max_depth < 1 || max_depth > 30) {
+                std::cerr << "Bad --depth (1-30)" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--escape-pct") == 0 && i + 1 < argc) {
+            escape_pct = atoi(argv[++i]);
+            if (escape_pct < 0 || escape_pct > 50) {
+                std::cerr << "Bad --escape-pct (0-50)" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--string-ratio") == 0 && i + 1 < argc) {
+            string_ratio = atof(argv[++i]);
+            if (string_ratio < 0.1 || string_ratio > 0.95) {
+                std::cerr << "Bad --string-ratio (0.1-0.95)" << std::endl;
+                return 1;
+            }
+        } else if (argv[i][0] != '-') {
+            output = argv[i];
+        } else {
+            std::cerr << "Usage: gen_dump [--bytes SIZE | --entries N] "
+                         "[--seed S] [--avg-entry BYTES] [--depth D] "
+                         "[--escape-pct P] [--string-ratio R] [output.json]"
+                      << std::endl;
+            return 2;
+        }
+    }
+
+    FILE* out = output ? fopen(output, "wb") : stdout;
+    if (!out) {
+        std::cerr << "Cannot open " << output << std::endl;
+        return 1;
+    }
+    // Large stdio buffer so entry-sized fwrites go out in big clusters.
+    static std::vector<char> iobuf(8 * 1024 * 1024);
+    setvbuf(out, iobuf.data(), _IOFBF, iobuf.size());
+
+    Rng rng(seed);
+
+    // Pre-randomized character pool; string values are slices of it, with
+    // escapes patched in at the requested density. No quotes or backslashes
+    // ever land in the pool, so a slice needs no per-byte checking.
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ._-";
+    std::vector<char> pool(1 << 20);
+    for (size_t i = 0; i < pool.size(); i++)
+        pool[i] = alphabet[rng.below(sizeof(alphabet) - 1)];
+    static const char* escapes[] = {"\\\"", "\\\\", "\\n", "\\t", "\\u00e9"};
+
+    std::string entry;
+    entry.reserve(4 * avg_entry);
+
+    // One "value": a quoted slice of the pool with escapes sprinkled in.
+    auto emit_string = [&](size_t len) {
+        entry += '"';
+        size_t off = rng.below(pool.size() - len - 1);
+        size_t done = 0;
+        while (done < len) {
+            // Run of plain bytes until the next escape site.
+            size_t run = (escape_pct > 0) ? 1 + rng.below(200 / escape_pct)
+                                          : len - done;
+            if (run > len - done) run = len - done;
+            entry.append(&pool[off + done], run);
+            done += run;
+            if (done < len && escape_pct > 0)
+                entry += escapes[rng.below(5)];
+        }
+        entry += '"';
+    };
+
+    // Nested property object totalling roughly `budget` bytes.
+    std::function<void(long long, int)> emit_object = [&](long long budget, int depth) {
+        entry += '{';
+        bool first = true;
+        while (budget > 0) {
+            if (!first) entry += ", ";
+            first = false;
+            char key[16];
+            int kn = snprintf(key, sizeof(key), "\"P%llu\": ",
+                              (unsigned long long)(1 + rng.below(9999)));
+            entry.append(key, kn);
+            budget -= kn + 2;
+            if (depth < max_depth && rng.below(100) < 15) {
+                // ~15% of values nest another object.
+                long long sub = budget / 2 + 1;
+                emit_object(sub, depth + 1);
+                budget -= sub;
+            } else {
+                long long sl = (long long)(budget * string_ratio);
+                long long cap = 16 + (long long)rng.below(2048);
+                if (sl > cap) sl = cap;
+                if (sl < 1) sl = 1;
+                emit_string((size_t)sl);
+                budget -= sl + 2;
+            }
+        }
+        entry += '}';
+    };
+
+    fwrite("{\n", 1, 2, out);
+    long long written = 2;
+    long long n = 0;
+    while (target_bytes > 0 ? written < target_bytes - 2
+                            : n < target_entries) {
+        n++;
+        entry.clear();
+        if (n > 1) entry += ",\n";
+        char key[32];
+        entry.append(key, snprintf(key, sizeof(key), "  \"Q%lld\": ", n));
+        // Entry sizes spread over roughly two orders of magnitude around the
+        // mean: pick a power-of-2 scale, then jitter inside it.
+        long long scale = avg_entry >> 3 << rng.below(4);
+        long long budget = scale + (long long)rng.below((uint64_t)scale);
+        emit_object(budget, 1);
+        fwrite(entry.data(), 1, entry.size(), out);
+        written += (long long)entry.size();
+    }
+    fwrite("\n}", 1, 2, out);
+    written += 2;
+
+    if (output) {
+        fclose(out);
+        fprintf(stderr, "Wrote %s: %lld entries, %lld bytes (seed %llu)\n",
+                output, n, written, (unsigned long long)seed);
+    } else {
+        fflush(out);
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Reusable core of the batch splitter: the top-level entry boundary scanner
+// and the index-sidecar primitives shared by split_json, lookup_entry and the
+// thin scan_entries front-end. Embedders (the ingest daemon, the Rust
+// comparison harness) link against this instead of fork/exec'ing split_json
+// and re-reading temp files.
+//
+// JsonEntryScanner is the portable scalar state machine; split_json keeps its
+// fused AVX2/NEON scan loops for the split hot path, but they implement the
+// same boundary semantics: an entry span runs from the byte after the
+// previous entry's closing brace (so it includes the ",\n" separator junk)
+// to the closing brace that returns nesting depth to the wrapper level.
+#ifndef JSON_ENTRY_SCANNER_H
+#define JSON_ENTRY_SCANNER_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// --- Entry-key offset index -------------------------------------------------
+// Binary sidecar written next to every batch file by split_json --index:
+// sorted records over the entries in that batch. v1 records were
+// (key-hash, offset, length); v2 appended the content hash used by --diff.
+
+struct IdxRecord {
+    uint64_t key_hash;
+    uint64_t offset;               // of the entry inside the batch file
+    uint64_t length;
+    uint64_t content_hash;         // over the entry from its key quote onward
+};
+
+static const char IDX_MAGIC_V1[8] = {'S','J','I','D','X','1','\n','\0'};
+static const char IDX_MAGIC_V2[8] = {'S','J','I','D','X','2','\n','\0'};
+
+// FNV-1a 64 over key bytes; the hash both index layouts are keyed on.
+static inline uint64_t key_hash64(const char* p, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Lift the depth-1 key ("Qxxx") out of a raw entry span.
+static inline bool span_key(const char* e, size_t n, const char** kp, size_t* kn) {
+    const char* q1 = (const char*)memchr(e, '"', n);
+    const char* q2 = q1 ? (const char*)memchr(q1 + 1, '"', n - (q1 + 1 - e)) : nullptr;
+    if (!q2) return false;
+    *kp = q1 + 1;
+    *kn = (size_t)(q2 - q1 - 1);
+    return true;
+}
+
+static inline void write_index(const std::string& batch_path,
+                               std::vector<IdxRecord>& recs) {
+    std::sort(recs.begin(), recs.end(),
+              [](const IdxRecord& a, const IdxRecord& b) { return a.key_hash < b.key_hash; });
+    std::string path = batch_path + ".idx";
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return;
+    uint64_t count = recs.size();
+    fwrite(IDX_MAGIC_V2, 1, 8, f);
+    fwrite(&count, sizeof(count), 1, f);
+    fwrite(recs.data(), sizeof(IdxRecord), recs.size(), f);
+    fclose(f);
+}
+
+// --- Streaming entry scanner ------------------------------------------------
+
+// Receives one complete entry span per call; spans point into the caller's
+// feed buffer (or the scanner's internal carry when an entry crossed a feed
+// boundary) and are only valid for the duration of the call.
+struct EntrySink {
+    virtual void entry(const char* e, size_t n) = 0;
+    virtual ~EntrySink() {}
+};
+
+// Incremental scanner over the wrapped dump format ({\n "Q1": {...},\n ...}).
+// feed() any number of buffers in order, then finish(); complete entries are
+// handed to the sink as they close. Partial trailing entries are carried
+// across feed calls, so the input never needs to be resident at once.
+struct JsonEntryScanner {
+    long long entries = 0;
+
+    void feed(const char* buf, size_t n, EntrySink& sink) {
+        size_t i = 0;
+        if (done)
+            return;
+        if (!started) {
+            // Skip to the wrapper's opening brace; the first span starts
+            // right after it.
+            while (i < n && buf[i] != '{')
+                i++;
+            if (i == n)
+                return;
+            started = true;
+            depth = 1;
+            i++;
+        }
+        size_t span_start = i;
+        for (; i < n; i++) {
+            char c = buf[i];
+            if (skip_escaped) {
+                skip_escaped = false;
+                continue;
+            }
+            if (in_string) {
+                if (c == '\\')
+                    skip_escaped = true;
+                else if (c == '"')
+                    in_string = false;
+                continue;
+            }
+            if (c == '"') {
+                in_string = true;
+            } else if (c == '{') {
+                depth++;
+            } else if (c == '}') {
+                depth--;
+                if (depth == 1) {
+                    // Completed a top-level entry.
+                    if (carry.empty()) {
+                        sink.entry(buf + span_start, i + 1 - span_start);
+                    } else {
+                        carry.append(buf + span_start, i + 1 - span_start);
+                        sink.entry(carry.data(), carry.size());
+                        carry.clear();
+                    }
+                    entries++;
+                    span_start = i + 1;
+                } else if (depth == 0) {
+                    // Wrapper closed; trailing bytes are not entries.
+                    done = true;
+                    return;
+                }
+            }
+        }
+        if (started && span_start < n)
+            carry.append(buf + span_start, n - span_start);
+    }
+
+    // Input exhausted; any carried partial entry is truncated and dropped.
+    void finish() {
+        carry.clear();
+        done = true;
+    }
+
+private:
+    bool started = false;          // wrapper '{' seen
+    bool done = false;             // wrapper '}' seen
+    bool in_string = false;
+    bool skip_escaped = false;     // next byte is escaped (across feeds)
+    int depth = 0;
+    std::string carry;             // partial entry spanning feed calls
+};
+
+#endif // JSON_ENTRY_SCANNER_H
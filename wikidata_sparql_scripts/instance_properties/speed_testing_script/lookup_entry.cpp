@@ -0,0 +1,152 @@
+// Point lookup of a single Q-id inside split batches, using the binary
+// .idx sidecars written by split_json --index. Each sidecar holds sorted
+// (key-hash, offset, length) records for one batch file; a lookup mmaps the
+// index, binary-searches the hash and reads just the matching entry bytes, so
+// a query over 80 batch files answers in microseconds instead of a grep over
+// gigabytes.
+//
+// Usage: lookup_entry [batches_dir] <key>        e.g. lookup_entry Q42
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "json_entry_scanner.h"
+
+// v1 records are (key_hash, offset, length); v2 appends the content hash used
+// by split_json --diff. Lookups only need the first three fields, so both
+// layouts are handled by walking the records at the right stride.
+
+// Check that the entry bytes really carry this key (hash collisions). The
+// key is the first quoted string in wrapped batches and the second one in
+// NDJSON records ({"id": "Qxxx", ...}), so look at both.
+static bool entry_has_key(const char* e, size_t n, const std::string& key) {
+    const char* p = e;
+    size_t left = n;
+    for (int str = 0; str < 2; str++) {
+        const char* q1 = (const char*)memchr(p, '"', left);
+        const char* q2 = q1 ? (const char*)memchr(q1 + 1, '"', n - (q1 + 1 - e)) : nullptr;
+        if (!q2) return false;
+        if ((size_t)(q2 - q1 - 1) == key.size() &&
+            memcmp(q1 + 1, key.data(), key.size()) == 0)
+            return true;
+        p = q2 + 1;
+        left = n - (size_t)(p - e);
+    }
+    return false;
+}
+
+// Search one batch's index; prints the entry and returns true on a hit.
+static bool lookup_in_batch(const std::string& batch_path, uint64_t hash,
+                            const std::string& key) {
+    std::string idx_path = batch_path + ".idx";
+    int fd = open(idx_path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 16) { close(fd); return false; }
+    const char* map = (const char*)mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    bool hit = false;
+    size_t stride = 0;
+    if (memcmp(map, IDX_MAGIC_V1, 8) == 0) stride = 24;
+    else if (memcmp(map, IDX_MAGIC_V2, 8) == 0) stride = 32;
+    if (stride > 0) {
+        uint64_t count;
+        memcpy(&count, map + 8, 8);
+        const char* recs = map + 16;
+        // (key_hash, offset, length) lead both record layouts.
+        auto field = [&](uint64_t i, int f) {
+            uint64_t v;
+            memcpy(&v, recs + i * stride + f * 8, 8);
+            return v;
+        };
+        if ((long long)(16 + count * stride) <= (long long)st.st_size) {
+            // Binary search for the first record with this hash.
+            uint64_t lo = 0, hi = count;
+            while (lo < hi) {
+                uint64_t mid = (lo + hi) / 2;
+                if (field(mid, 0) < hash) lo = mid + 1;
+                else hi = mid;
+            }
+            for (uint64_t i = lo; i < count && field(i, 0) == hash; i++) {
+                uint64_t off = field(i, 1), len = field(i, 2);
+                FILE* bf = fopen(batch_path.c_str(), "rb");
+                if (!bf) break;
+                char* buf = (char*)malloc(len);
+                if (buf && fseek(bf, (long)off, SEEK_SET) == 0 &&
+                    fread(buf, 1, len, bf) == len &&
+                    entry_has_key(buf, len, key)) {
+                    fwrite(buf, 1, len, stdout);
+                    fputc('\n', stdout);
+                    hit = true;
+                }
+                free(buf);
+                fclose(bf);
+                if (hit) break;
+            }
+        }
+    }
+    munmap((void*)map, st.st_size);
+    return hit;
+}
+
+int main(int argc, char** argv) {
+    std::string dir = "extracted_batches";
+    std::string key;
+
+    if (argc == 2) {
+        key = argv[1];
+    } else if (argc == 3) {
+        dir = argv[1];
+        key = argv[2];
+    } else {
+        std::cerr << "Usage: lookup_entry [batches_dir] <key>" << std::endl;
+        return 2;
+    }
+
+    uint64_t hash = key_hash64(key.data(), key.size());
+
+    // Sharded layouts (split_json --shards N) place batch file_num in
+    // shard_((file_num-1) % fanout); detect the fanout by probing the
+    // shard_NN directories.
+    int fanout = 0;
+    for (;; fanout++) {
+        char shard[256];
+        snprintf(shard, sizeof(shard), "%s/shard_%02d", dir.c_str(), fanout);
+        struct stat st;
+        if (stat(shard, &st) != 0 || !S_ISDIR(st.st_mode))
+            break;
+    }
+
+    const char* exts[] = {"json", "ndjson"};
+    for (int file_num = 1; ; file_num++) {
+        char name[256];
+        bool any = false;
+        for (const char* ext : exts) {
+            if (fanout > 0)
+                snprintf(name, sizeof(name), "%s/shard_%02d/extracted_data_%03d.%s",
+                         dir.c_str(), (file_num - 1) % fanout, file_num, ext);
+            else
+                snprintf(name, sizeof(name), "%s/extracted_data_%03d.%s",
+                         dir.c_str(), file_num, ext);
+            struct stat st;
+            if (stat(name, &st) != 0) continue;
+            any = true;
+            if (lookup_in_batch(name, hash, key))
+                return 0;
+        }
+        if (!any) break;               // ran past the last batch
+    }
+
+    std::cerr << key << " not found" << std::endl;
+    return 1;
+}
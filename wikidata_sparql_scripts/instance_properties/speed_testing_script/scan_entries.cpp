@@ -0,0 +1,134 @@
+// Thin front-end over JsonEntryScanner (json_entry_scanner.h): streams a
+// wrapped dump from a file or stdin through the scanner and either prints
+// entries, lists keys, filters by a key list, or summarizes entry sizes.
+// Mostly a working example of embedding the scanner; the full-featured
+// splitter remains split_json.
+//
+// Usage: scan_entries [--keys] [--sizes] [--filter-keys FILE] [input.json]
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "json_entry_scanner.h"
+
+// Separator junk ahead of the key inside a raw span.
+static size_t span_body(const char* e, size_t n) {
+    size_t i = 0;
+    while (i < n && (e[i] == ',' || e[i] == '\n' || e[i] == '\r' ||
+                     e[i] == ' ' || e[i] == '\t'))
+        i++;
+    return i;
+}
+
+struct PrintSink : EntrySink {
+    bool keys_only = false;
+    std::vector<std::string> filter;   // sorted; empty = pass everything
+    long long matched = 0;
+    long long bytes_min = -1, bytes_max = 0, bytes_total = 0;
+
+    void entry(const char* e, size_t n) override {
+        const char* kp;
+        size_t kn;
+        if (!span_key(e, n, &kp, &kn))
+            return;
+        if (!filter.empty() &&
+            !std::binary_search(filter.begin(), filter.end(), std::string(kp, kn)))
+            return;
+        matched++;
+        long long body = (long long)(n - span_body(e, n));
+        bytes_total += body;
+        if (bytes_min < 0 || body < bytes_min) bytes_min = body;
+        if (body > bytes_max) bytes_max = body;
+        if (keys_only) {
+            fwrite(kp, 1, kn, stdout);
+            fputc('\n', stdout);
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    PrintSink sink;
+    bool sizes = false;
+    bool print_entries = true;
+    const char* input = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--keys") == 0) {
+            sink.keys_only = true;
+            print_entries = false;
+        } else if (strcmp(argv[i], "--sizes") == 0) {
+            sizes = true;
+            print_entries = false;
+        } else if (strcmp(argv[i], "--filter-keys") == 0 && i + 1 < argc) {
+            std::ifstream f(argv[++i]);
+            if (!f) {
+                std::cerr << "Cannot open key list " << argv[i] << std::endl;
+                return 1;
+            }
+            std::string line;
+            while (std::getline(f, line)) {
+                while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+                    line.pop_back();
+                if (!line.empty())
+                    sink.filter.push_back(line);
+            }
+            std::sort(sink.filter.begin(), sink.filter.end());
+        } else if (argv[i][0] != '-') {
+            input = argv[i];
+        } else {
+            std::cerr << "Usage: scan_entries [--keys] [--sizes] "
+                         "[--filter-keys FILE] [input.json]" << std::endl;
+            return 2;
+        }
+    }
+
+    FILE* in = input ? fopen(input, "rb") : stdin;
+    if (!in) {
+        std::cerr << "Cannot open " << input << std::endl;
+        return 1;
+    }
+
+    // When printing whole entries, emit the span minus its separator junk.
+    struct RawSink : EntrySink {
+        PrintSink* inner;
+        void entry(const char* e, size_t n) override {
+            const char* kp;
+            size_t kn;
+            if (!span_key(e, n, &kp, &kn))
+                return;
+            if (!inner->filter.empty() &&
+                !std::binary_search(inner->filter.begin(), inner->filter.end(),
+                                    std::string(kp, kn)))
+                return;
+            inner->matched++;
+            size_t b = span_body(e, n);
+            fwrite(e + b, 1, n - b, stdout);
+            fputc('\n', stdout);
+        }
+    };
+    RawSink raw;
+    raw.inner = &sink;
+    EntrySink& use = print_entries ? (EntrySink&)raw : (EntrySink&)sink;
+
+    JsonEntryScanner scanner;
+    std::vector<char> buf(1 << 20);
+    size_t got;
+    while ((got = fread(buf.data(), 1, buf.size(), in)) > 0)
+        scanner.feed(buf.data(), got, use);
+    scanner.finish();
+    if (input)
+        fclose(in);
+
+    if (sizes && sink.matched > 0)
+        fprintf(stderr, "%lld entries, %lld bytes (min %lld, avg %lld, max %lld)\n",
+                sink.matched, sink.bytes_total, sink.bytes_min,
+                sink.bytes_total / sink.matched, sink.bytes_max);
+    else if (!print_entries)
+        fprintf(stderr, "%lld entries matched of %lld scanned\n",
+                sink.matched, scanner.entries);
+    return 0;
+}
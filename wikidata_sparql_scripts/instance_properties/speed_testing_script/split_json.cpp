@@ -1,143 +1,4056 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-const int CHUNK_SIZE = 500000;
+#include "json_entry_scanner.h"
 
-int main() {
-    std::string input_file = "extracted_data.json";
-    std::string output_dir = "extracted_batches";
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
-    mkdir(output_dir.c_str(), 0755);
+// Entries per batch; --chunk-size overrides (500k matches the historical
+// hardcoded split).
+static long long g_chunk_size = 500000;
 
-    std::ifstream in(input_file, std::ios::binary);
-    if (!in) {
-        std::cerr << "Cannot open " << input_file << std::endl;
-        return 1;
+// Rotate batches once this many output bytes have accumulated (0 = rotate on
+// entry count only). Entries vary from ~100 bytes to multi-MB, so byte-based
+// rotation keeps batch files uniformly sized; the entry-count cap still
+// applies as a secondary limit.
+static long long g_target_bytes = 0;
+
+static bool g_quiet = false;       // --quiet: no progress, no per-batch chatter
+
+// Batch output format: the historical wrapped object ({\n ... \n}) or one
+// {"id": "Qxxx", "value": {...}} record per line so downstream loaders can
+// stream batches with constant memory instead of json.load()ing 2-3 GB files.
+enum OutputFormat { FMT_WRAPPED, FMT_NDJSON };
+static OutputFormat g_format = FMT_WRAPPED;
+
+// --- Entry-key offset index -------------------------------------------------
+// --index writes a compact binary sidecar next to every batch file: sorted
+// (key-hash, offset, length) records over the entries in that batch, so a
+// single Q-id can be found with a binary search instead of grepping gigabytes.
+// The record layout, hash and writer live in json_entry_scanner.h, shared
+// with the lookup_entry tool that answers queries against them.
+
+static bool g_index = false;
+
+// --filter-keys: sorted Q-id list; an empty vector means no filtering. Keys
+// are matched by binary search against the depth-1 key lifted from the span
+// head, so non-matching entries are dropped at scan speed without ever being
+// buffered or written.
+static std::vector<std::string> g_filter_keys;
+
+static bool load_filter_keys(const std::string& path) {
+    std::ifstream f(path);
+    if (!f)
+        return false;
+    std::string line;
+    while (std::getline(f, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.pop_back();
+        if (!line.empty())
+            g_filter_keys.push_back(line);
     }
+    std::sort(g_filter_keys.begin(), g_filter_keys.end());
+    g_filter_keys.erase(std::unique(g_filter_keys.begin(), g_filter_keys.end()),
+                        g_filter_keys.end());
+    return !g_filter_keys.empty();
+}
 
-    in.seekg(0, std::ios::end);
-    long long file_size = in.tellg();
-    in.seekg(0, std::ios::beg);
-    std::cout << "File size: " << (file_size / 1024 / 1024) << " MB" << std::endl;
+static bool filter_match(const char* e, size_t n) {
+    const char* kp;
+    size_t kn;
+    if (!span_key(e, n, &kp, &kn))
+        return false;
+    // Q-ids fit in the small-string buffer, so this comparison key does not
+    // allocate per entry.
+    return std::binary_search(g_filter_keys.begin(), g_filter_keys.end(),
+                              std::string(kp, kn));
+}
 
-    int file_num = 1;
-    int entry_count = 0;
-    int total_entries = 0;
-    int brace_depth = 0;
-    bool in_string = false;
-    bool escape_next = false;
-    long long bytes_read = 0;
-    int last_percent = -1;
 
-    std::ofstream out;
-    char filename[256];
-    snprintf(filename, sizeof(filename), "%s/extracted_data_%03d.json", output_dir.c_str(), file_num);
-    out.open(filename);
-    out << "{\n";
-    bool first_in_file = true;
+// --- Buffer arena -----------------------------------------------------------
+// Fixed-size scan buffers (the fallback read buffer, the pipelined reader
+// pool, the async writer staging buffers) come from a slab arena instead of
+// malloc: slabs are 2 MB-aligned anonymous mappings advised onto transparent
+// huge pages, pre-faulted by the requesting thread so first-touch places them
+// on that thread's NUMA node, and recycled on release instead of being
+// returned to the allocator. Building with -DSPLIT_JSON_WITH_NUMA (and
+// -lnuma) binds slabs to the caller's node explicitly instead of relying on
+// first-touch.
+
+#if defined(SPLIT_JSON_WITH_NUMA) && __has_include(<numa.h>)
+#include <numa.h>
+#include <sched.h>
+#define SPLIT_JSON_HAVE_NUMA 1
+#endif
+
+const size_t ARENA_SLAB_ALIGN = 2 * 1024 * 1024;
+
+struct BufferArena {
+    // (pointer, mapped size) of released slabs, coarsely locked: get/put run
+    // a handful of times per run, never per entry.
+    std::vector<std::pair<char*, size_t>> free_slabs;
+    std::mutex mu;
+
+    static size_t slab_size(size_t n) {
+        return (n + ARENA_SLAB_ALIGN - 1) & ~(ARENA_SLAB_ALIGN - 1);
+    }
+
+    char* get(size_t n) {
+        n = slab_size(n);
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            for (size_t i = 0; i < free_slabs.size(); i++) {
+                if (free_slabs[i].second == n) {
+                    char* p = free_slabs[i].first;
+                    free_slabs.erase(free_slabs.begin() + i);
+                    return p;
+                }
+            }
+        }
+        void* p = mmap(nullptr, n, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+        madvise(p, n, MADV_HUGEPAGE);
+#ifdef SPLIT_JSON_HAVE_NUMA
+        if (numa_available() >= 0) {
+            int node = numa_node_of_cpu(sched_getcpu());
+            if (node >= 0)
+                numa_tonode_memory(p, n, node);
+        }
+#endif
+        // First touch from this thread commits the pages node-locally.
+        memset(p, 0, n);
+        return (char*)p;
+    }
+
+    void put(char* p, size_t n) {
+        if (!p)
+            return;
+        std::lock_guard<std::mutex> lock(mu);
+        free_slabs.push_back(std::make_pair(p, slab_size(n)));
+    }
 
-    std::string entry_buffer;
-    entry_buffer.reserve(50 * 1024);
+    ~BufferArena() {
+        for (size_t i = 0; i < free_slabs.size(); i++)
+            munmap(free_slabs[i].first, free_slabs[i].second);
+    }
+};
+
+static BufferArena g_arena;
 
-    char c;
+// --- Progress reporting -----------------------------------------------------
+// The scan loop only publishes plain counters (relaxed atomic stores at block
+// granularity); a background ticker turns them into a throughput/ETA display
+// once per second. No division or formatting ever happens on the hot path.
+struct ProgressReporter {
+    std::atomic<long long> bytes{0};
+    std::atomic<long long> entries{0};
+    std::atomic<int> file_num{1};
+    long long file_size = 0;
+    std::atomic<bool> stop{false};
+    std::thread ticker;
 
-    // Skip to first {
-    while (in.get(c)) {
-        bytes_read++;
-        if (c == '{') break;
+    void start(long long total_bytes) {
+        file_size = total_bytes;
+        if (g_quiet) return;
+        ticker = std::thread([this]() { run(); });
     }
-    brace_depth = 1;
 
-    while (in.get(c)) {
-        bytes_read++;
+    void run() {
+        time_t t0 = time(nullptr);
+        long long last_bytes = 0, last_entries = 0;
+        while (!stop.load(std::memory_order_acquire)) {
+            struct timespec ts = {1, 0};
+            nanosleep(&ts, nullptr);
+            long long b = bytes.load(std::memory_order_relaxed);
+            long long e = entries.load(std::memory_order_relaxed);
+            long long mbs = (b - last_bytes) / (1024 * 1024);
+            long long eps = e - last_entries;
+            last_bytes = b;
+            last_entries = e;
 
-        // Progress
-        int percent = (bytes_read * 100) / file_size;
-        if (percent != last_percent) {
-            std::cout << "\rProgress: " << percent << "% | Entries: " << total_entries
-                      << " | File: " << file_num << "   " << std::flush;
-            last_percent = percent;
+            int percent = file_size > 0 ? (int)(b * 100 / file_size) : 0;
+            long long eta = -1;
+            time_t elapsed = time(nullptr) - t0;
+            if (b > 0 && elapsed > 0)
+                eta = (file_size - b) * elapsed / b;
+
+            std::cout << "\rProgress: " << percent << "% | " << mbs << " MB/s | "
+                      << eps << " entries/s | Entries: " << e << " | File: "
+                      << file_num.load(std::memory_order_relaxed);
+            if (eta >= 0)
+                std::cout << " | ETA " << eta / 60 << "m" << eta % 60 << "s";
+            std::cout << "   " << std::flush;
         }
+    }
 
-        // Handle escape sequences
-        if (escape_next) {
-            entry_buffer += c;
-            escape_next = false;
-            continue;
+    void finish() {
+        stop.store(true, std::memory_order_release);
+        if (ticker.joinable()) ticker.join();
+    }
+    ~ProgressReporter() { finish(); }
+};
+
+// Input engine: mmap the whole file and hand it out as one block, with a
+// buffered-read fallback for filesystems where mmap fails (NFS, pipes, ...).
+// The scan loop below only sees (pointer, length) blocks either way.
+struct InputSource {
+    int fd = -1;
+    const char* map = nullptr;     // mmap path
+    long long map_size = 0;
+    long long map_off = 0;
+    FILE* f = nullptr;             // fallback path
+    char* buf = nullptr;
+    long long file_size = 0;
+    bool mapped = false;
+};
+
+// Read granularity for both the mmap slices and the buffered fallback;
+// --block-size overrides.
+static size_t g_block_size = 8 * 1024 * 1024;
+
+// --follow: tail a still-growing dump so splitting overlaps the hours-long
+// SPARQL extraction. EOF on the input becomes "poll until more bytes appear";
+// the scan stops by itself when the wrapper's closing brace arrives. The stop
+// flag releases a reader thread still polling after the scan finished.
+static bool g_follow = false;
+static std::atomic<bool> g_follow_stop{false};
+
+// Position the input at an absolute byte offset (used by --resume).
+bool input_seek(InputSource& in, long long pos) {
+    if (in.mapped) {
+        if (pos > in.map_size) return false;
+        in.map_off = pos;
+        return true;
+    }
+    return fseek(in.f, pos, SEEK_SET) == 0;
+}
+
+bool input_open(InputSource& in, const std::string& path) {
+    if (path == "-") {
+        // stdin: size unknown, buffered reads only.
+        in.fd = 0;
+        in.f = stdin;
+        in.buf = g_arena.get(g_block_size);
+        return in.buf != nullptr;
+    }
+    in.fd = open(path.c_str(), O_RDONLY);
+    if (in.fd < 0) return false;
+
+    struct stat st;
+    if (fstat(in.fd, &st) != 0) { close(in.fd); return false; }
+    in.file_size = st.st_size;
+
+    // Named pipes cannot be mapped, and a file still being written must be
+    // read through the buffered path so --follow sees bytes past the size at
+    // open time.
+    void* p = (S_ISREG(st.st_mode) && !g_follow)
+                  ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, in.fd, 0)
+                  : MAP_FAILED;
+    if (p != MAP_FAILED) {
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        in.map = (const char*)p;
+        in.map_size = st.st_size;
+        in.mapped = true;
+        return true;
+    }
+
+    // mmap refused (e.g. some network filesystems): buffered reads instead
+    in.f = fdopen(in.fd, "rb");
+    if (!in.f) { close(in.fd); return false; }
+    in.buf = g_arena.get(g_block_size);
+    return in.buf != nullptr;
+}
+
+// Returns the next block of input, or false at EOF.
+bool input_next_block(InputSource& in, const char** data, size_t* len) {
+    if (in.mapped) {
+        if (in.map_off >= in.map_size) return false;
+        long long n = in.map_size - in.map_off;
+        if (n > (long long)g_block_size) n = g_block_size;
+        *data = in.map + in.map_off;
+        *len = (size_t)n;
+        in.map_off += n;
+        return true;
+    }
+    size_t n = fread(in.buf, 1, g_block_size, in.f);
+    while (n == 0 && g_follow &&
+           !g_follow_stop.load(std::memory_order_acquire)) {
+        // Tail mode: EOF just means the extractor has not caught up yet.
+        clearerr(in.f);
+        struct timespec ts = {0, 200 * 1000 * 1000};
+        nanosleep(&ts, nullptr);
+        n = fread(in.buf, 1, g_block_size, in.f);
+    }
+    if (n == 0) return false;
+    *data = in.buf;
+    *len = n;
+    return true;
+}
+
+void input_close(InputSource& in) {
+    if (in.mapped) {
+        munmap((void*)in.map, in.map_size);
+        close(in.fd);
+    } else if (in.f) {
+        if (in.f != stdin)
+            fclose(in.f);   // closes fd too
+        g_arena.put(in.buf, g_block_size);
+    }
+}
+
+// --- Bounded lock-free SPSC queue -------------------------------------------
+// Single producer, single consumer; push/pop spin-wait with yield when the
+// ring is full/empty. close() lets the consumer drain and stop.
+template <typename T, size_t N>
+struct SpscQueue {
+    T slots[N];
+    std::atomic<size_t> head{0};   // next slot to pop
+    std::atomic<size_t> tail{0};   // next slot to push
+    std::atomic<bool> closed{false};
+
+    void push(T&& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        while (t - head.load(std::memory_order_acquire) >= N) {
+            if (closed.load(std::memory_order_acquire)) return;   // consumer gone
+            std::this_thread::yield();
         }
+        slots[t % N] = std::move(v);
+        tail.store(t + 1, std::memory_order_release);
+    }
 
-        if (c == '\\' && in_string) {
-            entry_buffer += c;
-            escape_next = true;
-            continue;
+    // Returns false once the queue is closed and drained.
+    bool pop(T& v) {
+        size_t h = head.load(std::memory_order_relaxed);
+        while (h == tail.load(std::memory_order_acquire)) {
+            if (closed.load(std::memory_order_acquire) &&
+                h == tail.load(std::memory_order_acquire))
+                return false;
+            std::this_thread::yield();
         }
+        v = std::move(slots[h % N]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
 
-        // Handle strings
-        if (c == '"') {
-            in_string = !in_string;
-            entry_buffer += c;
-            continue;
+    void close() { closed.store(true, std::memory_order_release); }
+};
+
+// --- Structural-character scanner -------------------------------------------
+// Stage 1 of the scan (simdjson-style): classify 64 input bytes at a time and
+// return a bitmap with a bit set at every '{', '}', '"' and '\'. On typical
+// dumps <2% of bytes are structural, so the boundary state machine only has
+// to look at set bits and everything in between is appended in bulk.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+static uint64_t structural_bits_sse2(const char* p) {
+    const __m128i ob = _mm_set1_epi8('{');
+    const __m128i cb = _mm_set1_epi8('}');
+    const __m128i qu = _mm_set1_epi8('"');
+    const __m128i bs = _mm_set1_epi8('\\');
+    uint64_t bits = 0;
+    for (int i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, ob), _mm_cmpeq_epi8(v, cb)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, qu), _mm_cmpeq_epi8(v, bs)));
+        bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(m) << i;
+    }
+    return bits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t structural_bits_avx2(const char* p) {
+    const __m256i ob = _mm256_set1_epi8('{');
+    const __m256i cb = _mm256_set1_epi8('}');
+    const __m256i qu = _mm256_set1_epi8('"');
+    const __m256i bs = _mm256_set1_epi8('\\');
+    uint64_t bits = 0;
+    for (int i = 0; i < 64; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, ob), _mm256_cmpeq_epi8(v, cb)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, qu), _mm256_cmpeq_epi8(v, bs)));
+        bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(m) << i;
+    }
+    return bits;
+}
+
+#elif defined(__aarch64__)
+
+static uint64_t structural_bits_neon(const char* p) {
+    const uint8x16_t ob = vdupq_n_u8('{');
+    const uint8x16_t cb = vdupq_n_u8('}');
+    const uint8x16_t qu = vdupq_n_u8('"');
+    const uint8x16_t bs = vdupq_n_u8('\\');
+    uint64_t bits = 0;
+    for (int i = 0; i < 64; i += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)(p + i));
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, ob), vceqq_u8(v, cb)),
+                                vorrq_u8(vceqq_u8(v, qu), vceqq_u8(v, bs)));
+        // Narrow each byte-lane to 4 bits, then pick one bit per lane.
+        uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+        uint64_t packed = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+        uint64_t lane_bits = 0;
+        for (int b = 0; b < 16; b++)
+            lane_bits |= ((packed >> (b * 4)) & 1ULL) << b;
+        bits |= lane_bits << i;
+    }
+    return bits;
+}
+
+#endif
+
+[[maybe_unused]] static uint64_t structural_bits_scalar(const char* p) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 64; i++) {
+        char c = p[i];
+        if (c == '{' || c == '}' || c == '"' || c == '\\')
+            bits |= 1ULL << i;
+    }
+    return bits;
+}
+
+typedef uint64_t (*structural_fn)(const char*);
+
+// Pick the widest scanner the running CPU supports.
+static structural_fn select_structural_fn(const char** name) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) { *name = "avx2"; return structural_bits_avx2; }
+    *name = "sse2";
+    return structural_bits_sse2;
+#elif defined(__aarch64__)
+    *name = "neon";
+    return structural_bits_neon;
+#else
+    *name = "scalar";
+    return structural_bits_scalar;
+#endif
+}
+
+// --- Pipeline stages --------------------------------------------------------
+// The scanner pulls input blocks from a BlockProvider and pushes batch-file
+// bytes into a BatchWriter. Direct implementations run everything on the
+// calling thread (the historical behavior); the pipelined implementations put
+// the reader and the writer on their own threads behind SPSC queues, so disk
+// reads, scanning and batch writes overlap. Output bytes are identical in
+// both modes because the writer consumes commands strictly in scan order.
+
+struct BlockProvider {
+    virtual bool next_block(const char** data, size_t* len) = 0;
+    // True when block memory stays valid after the next next_block() call
+    // (mmap slices); false for recycled read buffers.
+    virtual bool stable() const = 0;
+    virtual ~BlockProvider() {}
+};
+
+struct BatchWriter {
+    virtual void open_batch(int file_num) = 0;
+    virtual void write(std::string&& data) = 0;
+    // Entry bytes referenced in place; no copy on the direct path.
+    virtual void write_span(const char* p, size_t n) = 0;
+    virtual void close_batch(int file_num, int entry_count) = 0;
+    virtual void finish() = 0;
+    // Bytes written to the currently open batch, or -1 when the writer can't
+    // say (async/pipelined sinks); checkpointing needs an exact answer.
+    virtual long long batch_bytes() const { return -1; }
+    // Push buffered batch bytes down to the OS (taken before a checkpoint).
+    virtual void sync_batch() {}
+    virtual ~BatchWriter() {}
+};
+
+// Batch naming stem; must contain one integer printf directive for the file
+// number (--pattern overrides, e.g. "dump-%05d").
+static std::string g_name_pattern = "extracted_data_%03d";
+
+// --shards N spreads batch files over shard_00 .. shard_NN subdirectories
+// (assignment: (file_num - 1) % fanout) so low batch sizes do not funnel
+// thousands of creates into one directory entry on NFS scratch space.
+static int g_shard_fanout = 0;     // 0 = flat output directory
+
+static std::string batch_filename(const std::string& output_dir, int file_num) {
+    char filename[512];
+    if (g_shard_fanout > 0) {
+        char dir[384];
+        snprintf(dir, sizeof(dir), "%s/shard_%02d", output_dir.c_str(),
+                 (file_num - 1) % g_shard_fanout);
+        snprintf(filename, sizeof(filename), ("%s/" + g_name_pattern + ".%s").c_str(),
+                 dir, file_num, g_format == FMT_NDJSON ? "ndjson" : "json");
+    } else {
+        snprintf(filename, sizeof(filename), ("%s/" + g_name_pattern + ".%s").c_str(),
+                 output_dir.c_str(), file_num,
+                 g_format == FMT_NDJSON ? "ndjson" : "json");
+    }
+    return filename;
+}
+
+// Batch-to-shard manifest, written once the final file count is known, so
+// downstream jobs can enumerate every batch without a directory walk.
+static bool write_shard_manifest(const std::string& output_dir, int files) {
+    std::string path = output_dir + "/shard_manifest.json";
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f)
+        return false;
+    fprintf(f, "{\n");
+    fprintf(f, "  \"fanout\": %d,\n", g_shard_fanout);
+    fprintf(f, "  \"batches\": %d,\n", files);
+    fprintf(f, "  \"shards\": [");
+    for (int sh = 0; sh < g_shard_fanout; sh++) {
+        fprintf(f, "%s\n    {\"shard\": \"shard_%02d\", \"files\": [", sh ? "," : "", sh);
+        bool first = true;
+        for (int n = sh + 1; n <= files; n += g_shard_fanout) {
+            fprintf(f, "%s\"%s\"", first ? "" : ", ",
+                    batch_filename(output_dir, n).c_str());
+            first = false;
         }
+        fprintf(f, "]}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+// Parse a byte size with an optional K/M/G suffix ("8M", "1G", "262144").
+static long long parse_size(const char* s) {
+    char* end = nullptr;
+    long long v = strtoll(s, &end, 10);
+    if (end == s || v < 0) return -1;
+    switch (*end) {
+    case 0: break;
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    default: return -1;
+    }
+    return *end == 0 ? v : -1;
+}
 
+// Append JSON bytes with the pretty-printing stripped: whitespace outside
+// strings goes away so the record really is a single line.
+static void append_minified(std::string& out, const char* p, size_t n) {
+    bool in_string = false;
+    bool escaped = false;
+    for (size_t i = 0; i < n; i++) {
+        char c = p[i];
         if (in_string) {
-            entry_buffer += c;
+            out += c;
+            if (escaped) escaped = false;
+            else if (c == '\\') escaped = true;
+            else if (c == '"') in_string = false;
             continue;
         }
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            continue;
+        out += c;
+        if (c == '"') in_string = true;
+    }
+}
+
+// Turn one raw entry span (separator junk, "Qxxx" key, value object) into an
+// NDJSON record. Falls back to the raw bytes if the head does not parse.
+static std::string ndjson_record(const char* e, size_t n) {
+    const char* q1 = (const char*)memchr(e, '"', n);
+    const char* q2 = q1 ? (const char*)memchr(q1 + 1, '"', n - (q1 + 1 - e)) : nullptr;
+    const char* v = q2 ? (const char*)memchr(q2 + 1, '{', n - (q2 + 1 - e)) : nullptr;
+    std::string line;
+    if (v) {
+        line.reserve((size_t)(e + n - v) + (size_t)(q2 - q1) + 32);
+        line.append("{\"id\": ");
+        line.append(q1, (size_t)(q2 + 1 - q1));
+        line.append(", \"value\": ");
+        append_minified(line, v, (size_t)(e + n - v));
+        line.append("}\n");
+    } else {
+        append_minified(line, e, n);
+        line.append("\n");
+    }
+    return line;
+}
 
-        // Track braces outside strings
-        if (c == '{') {
-            brace_depth++;
-            entry_buffer += c;
-        } else if (c == '}') {
-            brace_depth--;
-            entry_buffer += c;
+struct DirectBlockProvider : BlockProvider {
+    InputSource& in;
+    explicit DirectBlockProvider(InputSource& src) : in(src) {}
+    bool next_block(const char** data, size_t* len) override {
+        return input_next_block(in, data, len);
+    }
+    bool stable() const override { return in.mapped; }
+};
 
-            // Completed a top-level entry (depth back to 1)
-            if (brace_depth == 1) {
-                if (!first_in_file) {
-                    out << ",\n";
+struct DirectBatchWriter : BatchWriter {
+    std::string output_dir;
+    std::ofstream out;
+    std::string current_name;
+    long long written = 0;
+
+    explicit DirectBatchWriter(const std::string& dir) : output_dir(dir) {}
+
+    void open_batch(int file_num) override {
+        current_name = batch_filename(output_dir, file_num);
+        out.open(current_name);
+        written = 0;
+    }
+    // Reopen a partially written batch at a known-good size (--resume).
+    bool resume_batch(int file_num, long long good_bytes) {
+        current_name = batch_filename(output_dir, file_num);
+        struct stat st;
+        if (stat(current_name.c_str(), &st) != 0 || st.st_size < good_bytes) {
+            std::cerr << current_name << " is shorter than the checkpoint says; "
+                      << "restart the split from scratch" << std::endl;
+            return false;
+        }
+        if (truncate(current_name.c_str(), good_bytes) != 0)
+            return false;
+        out.open(current_name, std::ios::app);
+        written = good_bytes;
+        return true;
+    }
+    void write(std::string&& data) override {
+        out.write(data.data(), data.size());
+        written += (long long)data.size();
+    }
+    void write_span(const char* p, size_t n) override {
+        out.write(p, n);
+        written += (long long)n;
+    }
+    void close_batch(int, int entry_count) override {
+        out.close();
+        if (!g_quiet)
+            std::cout << "\nWrote " << current_name << " (" << entry_count << " entries)" << std::endl;
+    }
+    void finish() override {}
+    long long batch_bytes() const override { return written; }
+    void sync_batch() override { out.flush(); }
+};
+
+// Reader thread: fills a small pool of buffers ahead of the scanner. In mmap
+// mode no copying happens, the "reader" just slices the mapping.
+struct ReaderBlock {
+    const char* data = nullptr;
+    size_t len = 0;
+    int buf_id = -1;               // fallback-pool slot, -1 for mmap slices
+};
+
+struct PipelinedBlockProvider : BlockProvider {
+    static const int POOL_BUFS = 4;
+
+    InputSource& in;
+    SpscQueue<ReaderBlock, 8> blocks;
+    SpscQueue<int, 8> free_bufs;
+    std::vector<char*> pool;
+    std::thread reader;
+    int last_buf_id = -1;
+
+    explicit PipelinedBlockProvider(InputSource& src) : in(src) {
+        if (!in.mapped) {
+            for (int i = 0; i < POOL_BUFS; i++) {
+                pool.push_back(g_arena.get(g_block_size));
+                free_bufs.push(int(i));
+            }
+        }
+        reader = std::thread([this]() { run(); });
+    }
+
+    void run() {
+        if (in.mapped) {
+            const char* data;
+            size_t len;
+            while (input_next_block(in, &data, &len))
+                blocks.push(ReaderBlock{data, len, -1});
+        } else {
+            for (;;) {
+                int id;
+                if (!free_bufs.pop(id)) break;
+                size_t n = fread(pool[id], 1, g_block_size, in.f);
+                while (n == 0 && g_follow &&
+                       !g_follow_stop.load(std::memory_order_acquire)) {
+                    clearerr(in.f);
+                    struct timespec ts = {0, 200 * 1000 * 1000};
+                    nanosleep(&ts, nullptr);
+                    n = fread(pool[id], 1, g_block_size, in.f);
                 }
-                first_in_file = false;
-                out << entry_buffer;
-                entry_buffer.clear();
+                if (n == 0) break;
+                blocks.push(ReaderBlock{pool[id], n, id});
+            }
+        }
+        blocks.close();
+    }
+
+    bool next_block(const char** data, size_t* len) override {
+        if (last_buf_id >= 0) {
+            free_bufs.push(int(last_buf_id));   // recycle the drained buffer
+            last_buf_id = -1;
+        }
+        ReaderBlock b;
+        if (!blocks.pop(b)) return false;
+        *data = b.data;
+        *len = b.len;
+        last_buf_id = b.buf_id;
+        return true;
+    }
+
+    bool stable() const override { return in.mapped; }
+
+    ~PipelinedBlockProvider() {
+        g_follow_stop.store(true, std::memory_order_release);
+        free_bufs.close();
+        blocks.close();
+        if (reader.joinable()) reader.join();
+        for (char* p : pool) g_arena.put(p, g_block_size);
+    }
+};
+
+// Writer thread: consumes open/data/close commands in scan order. Spans into
+// stable (mmap) input are passed by reference; anything else is copied into
+// the command because read buffers get recycled before the writer catches up.
+struct WriteCmd {
+    enum Op { Open, Data, DataSpan, Close } op = Data;
+    int file_num = 0;
+    int entry_count = 0;
+    std::string data;
+    const char* ptr = nullptr;
+    size_t len = 0;
+};
+
+struct PipelinedBatchWriter : BatchWriter {
+    std::string output_dir;
+    bool spans_stable;
+    SpscQueue<WriteCmd, 1024> cmds;
+    std::thread writer;
+
+    PipelinedBatchWriter(const std::string& dir, bool stable_input)
+        : output_dir(dir), spans_stable(stable_input) {
+        writer = std::thread([this]() { run(); });
+    }
+
+    void run() {
+        std::ofstream out;
+        std::string current_name;
+        WriteCmd c;
+        while (cmds.pop(c)) {
+            switch (c.op) {
+            case WriteCmd::Open:
+                current_name = batch_filename(output_dir, c.file_num);
+                out.open(current_name);
+                break;
+            case WriteCmd::Data:
+                out.write(c.data.data(), c.data.size());
+                break;
+            case WriteCmd::DataSpan:
+                out.write(c.ptr, c.len);
+                break;
+            case WriteCmd::Close:
+                out.close();
+                if (!g_quiet)
+                    std::cout << "\nWrote " << current_name << " (" << c.entry_count << " entries)" << std::endl;
+                break;
+            }
+        }
+    }
+
+    void open_batch(int file_num) override {
+        cmds.push(WriteCmd{WriteCmd::Open, file_num, 0, std::string()});
+    }
+    void write(std::string&& data) override {
+        cmds.push(WriteCmd{WriteCmd::Data, 0, 0, std::move(data)});
+    }
+    void write_span(const char* p, size_t n) override {
+        if (spans_stable) {
+            cmds.push(WriteCmd{WriteCmd::DataSpan, 0, 0, std::string(), p, n});
+        } else {
+            cmds.push(WriteCmd{WriteCmd::Data, 0, 0, std::string(p, n)});
+        }
+    }
+    void close_batch(int file_num, int entry_count) override {
+        cmds.push(WriteCmd{WriteCmd::Close, file_num, entry_count, std::string()});
+    }
+    void finish() override {
+        cmds.close();
+        if (writer.joinable()) writer.join();
+    }
+    ~PipelinedBatchWriter() { finish(); }
+};
+
+// --- Asynchronous batch output ----------------------------------------------
+// Batch bytes are staged into large page-aligned buffers; full buffers are
+// handed to a backend that writes them at explicit offsets while the scanner
+// keeps running, so batch flushes and file rotation no longer stall the scan
+// loop. The backend is io_uring when liburing is present at build time, and a
+// plain pwrite writer thread otherwise; both preserve the exact
+// extracted_data_%03d.json naming and "{\n ... \n}" wrapping.
+
+#if __has_include(<liburing.h>)
+#include <liburing.h>
+#define SPLIT_JSON_HAVE_LIBURING 1
+#endif
+
+struct AsyncBatchWriter : BatchWriter {
+    static const size_t BUF_SIZE = 8 * 1024 * 1024;
+    static const size_t BUF_ALIGN = 4096;
+    static const int NBUFS = 4;
+
+    struct Op {
+        enum Kind { Open, Write, Close } kind = Write;
+        std::string name;
+        int buf_id = 0;
+        size_t len = 0;
+        long long offset = 0;
+        int entry_count = 0;
+    };
 
-                entry_count++;
-                total_entries++;
+    std::string output_dir;
+    char* bufs[NBUFS];
+    SpscQueue<int, NBUFS + 1> free_bufs;
+    SpscQueue<Op, 64> ops;
+    std::thread backend;
 
-                // Check if need new file
-                if (entry_count >= CHUNK_SIZE) {
-                    out << "\n}";
-                    out.close();
-                    std::cout << "\nWrote " << filename << " (" << entry_count << " entries)" << std::endl;
+    int cur_buf = -1;
+    size_t cur_len = 0;
+    long long file_off = 0;
 
-                    file_num++;
-                    entry_count = 0;
-                    snprintf(filename, sizeof(filename), "%s/extracted_data_%03d.json", output_dir.c_str(), file_num);
-                    out.open(filename);
-                    out << "{\n";
-                    first_in_file = true;
+    explicit AsyncBatchWriter(const std::string& dir) : output_dir(dir) {
+        for (int i = 0; i < NBUFS; i++) {
+            bufs[i] = g_arena.get(BUF_SIZE);   // 2 MB-aligned, covers BUF_ALIGN
+            if (i > 0)
+                free_bufs.push(int(i));
+        }
+        cur_buf = 0;
+        backend = std::thread([this]() { run(); });
+    }
+
+    void append(const char* p, size_t n) {
+        while (n > 0) {
+            size_t room = BUF_SIZE - cur_len;
+            size_t take = n < room ? n : room;
+            memcpy(bufs[cur_buf] + cur_len, p, take);
+            cur_len += take;
+            p += take;
+            n -= take;
+            if (cur_len == BUF_SIZE)
+                flush_buf();
+        }
+    }
+
+    void flush_buf() {
+        if (cur_len == 0) return;
+        ops.push(Op{Op::Write, std::string(), cur_buf, cur_len, file_off, 0});
+        file_off += (long long)cur_len;
+        cur_len = 0;
+        if (!free_bufs.pop(cur_buf))       // blocks while both buffers in flight
+            cur_buf = 0;
+    }
+
+    void open_batch(int file_num) override {
+        ops.push(Op{Op::Open, batch_filename(output_dir, file_num), 0, 0, 0, 0});
+        file_off = 0;
+    }
+    void write(std::string&& data) override { append(data.data(), data.size()); }
+    void write_span(const char* p, size_t n) override { append(p, n); }
+    void close_batch(int, int entry_count) override {
+        flush_buf();
+        ops.push(Op{Op::Close, std::string(), 0, 0, 0, entry_count});
+    }
+    void finish() override {
+        flush_buf();
+        ops.close();
+        if (backend.joinable()) backend.join();
+    }
+    ~AsyncBatchWriter() {
+        finish();
+        free_bufs.close();
+        for (int i = 0; i < NBUFS; i++) g_arena.put(bufs[i], BUF_SIZE);
+    }
+
+#ifdef SPLIT_JSON_HAVE_LIBURING
+    // io_uring backend: writes are submitted at explicit offsets and completed
+    // out of order; open/close act as barriers that drain in-flight writes.
+    void run() {
+        struct io_uring ring;
+        if (io_uring_queue_init(NBUFS * 2, &ring, 0) != 0) {
+            run_pwrite();
+            return;
+        }
+        int fd = -1;
+        std::string cur_name;
+        int inflight = 0;
+
+        auto drain = [&](int down_to) {
+            while (inflight > down_to) {
+                struct io_uring_cqe* cqe;
+                if (io_uring_wait_cqe(&ring, &cqe) != 0) break;
+                free_bufs.push((int)(intptr_t)io_uring_cqe_get_data(cqe));
+                io_uring_cqe_seen(&ring, cqe);
+                inflight--;
+            }
+        };
+
+        Op op;
+        while (ops.pop(op)) {
+            switch (op.kind) {
+            case Op::Open:
+                drain(0);
+                cur_name = op.name;
+                fd = open(op.name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                break;
+            case Op::Write: {
+                struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+                if (!sqe) { drain(inflight - 1); sqe = io_uring_get_sqe(&ring); }
+                io_uring_prep_write(sqe, fd, bufs[op.buf_id], op.len, op.offset);
+                io_uring_sqe_set_data(sqe, (void*)(intptr_t)op.buf_id);
+                io_uring_submit(&ring);
+                inflight++;
+                break;
+            }
+            case Op::Close:
+                drain(0);
+                close(fd);
+                fd = -1;
+                if (!g_quiet)
+                    std::cout << "\nWrote " << cur_name << " (" << op.entry_count << " entries)" << std::endl;
+                break;
+            }
+        }
+        drain(0);
+        if (fd >= 0) close(fd);
+        io_uring_queue_exit(&ring);
+    }
+#else
+    void run() { run_pwrite(); }
+#endif
+
+    // Fallback backend: a dedicated thread issuing plain pwrites.
+    void run_pwrite() {
+        int fd = -1;
+        std::string cur_name;
+        Op op;
+        while (ops.pop(op)) {
+            switch (op.kind) {
+            case Op::Open:
+                cur_name = op.name;
+                fd = open(op.name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                break;
+            case Op::Write: {
+                size_t off = 0;
+                while (off < op.len) {
+                    ssize_t n = pwrite(fd, bufs[op.buf_id] + off, op.len - off,
+                                       op.offset + (long long)off);
+                    if (n <= 0) break;
+                    off += (size_t)n;
                 }
-            } else if (brace_depth == 0) {
-                // End of file
+                free_bufs.push(int(op.buf_id));
+                break;
+            }
+            case Op::Close:
+                close(fd);
+                fd = -1;
+                if (!g_quiet)
+                    std::cout << "\nWrote " << cur_name << " (" << op.entry_count << " entries)" << std::endl;
                 break;
             }
-        } else if (brace_depth == 1 && c == '"') {
-            // Start of new key at depth 1
-            entry_buffer += c;
-        } else if (brace_depth >= 1) {
-            entry_buffer += c;
         }
+        if (fd >= 0) close(fd);
     }
+};
 
-    // Write remaining
-    if (entry_count > 0) {
-        out << "\n}";
-        out.close();
-        std::cout << "\nWrote " << filename << " (" << entry_count << " entries)" << std::endl;
+
+// --- Inline zstd compression ------------------------------------------------
+// --compress zstd:N streams each batch through a zstd encoder on its own
+// thread and writes extracted_data_NNN.json.zst directly, cutting output I/O
+// ~8x on these dumps and removing the separate post-split compression pass.
+// Compiled in only when libzstd headers are present.
+
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define SPLIT_JSON_HAVE_ZSTD 1
+#endif
+
+#ifdef SPLIT_JSON_HAVE_ZSTD
+
+struct ZstdBatchWriter : BatchWriter {
+    std::string output_dir;
+    int level;
+    SpscQueue<WriteCmd, 1024> cmds;
+    std::thread comp;
+
+    ZstdBatchWriter(const std::string& dir, int lvl) : output_dir(dir), level(lvl) {
+        comp = std::thread([this]() { run(); });
+    }
+
+    void run() {
+        ZSTD_CCtx* cctx = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+        size_t out_cap = ZSTD_CStreamOutSize();
+        char* out_buf = (char*)malloc(out_cap);
+        FILE* f = nullptr;
+        std::string cur_name;
+        int pending_entries = 0;
+
+        auto pump = [&](const char* p, size_t n, ZSTD_EndDirective mode) {
+            ZSTD_inBuffer inb = {p, n, 0};
+            for (;;) {
+                ZSTD_outBuffer outb = {out_buf, out_cap, 0};
+                size_t rc = ZSTD_compressStream2(cctx, &outb, &inb, mode);
+                if (outb.pos > 0 && f)
+                    fwrite(out_buf, 1, outb.pos, f);
+                if (ZSTD_isError(rc)) break;
+                if (mode == ZSTD_e_end ? rc == 0 : inb.pos == inb.size) break;
+            }
+        };
+
+        WriteCmd c;
+        while (cmds.pop(c)) {
+            switch (c.op) {
+            case WriteCmd::Open:
+                cur_name = batch_filename(output_dir, c.file_num) + ".zst";
+                f = fopen(cur_name.c_str(), "wb");
+                ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+                ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+                break;
+            case WriteCmd::Data:
+            case WriteCmd::DataSpan:
+                pump(c.op == WriteCmd::Data ? c.data.data() : c.ptr,
+                     c.op == WriteCmd::Data ? c.data.size() : c.len,
+                     ZSTD_e_continue);
+                break;
+            case WriteCmd::Close:
+                pump(nullptr, 0, ZSTD_e_end);
+                if (f) { fclose(f); f = nullptr; }
+                pending_entries = c.entry_count;
+                if (!g_quiet)
+                    std::cout << "\nWrote " << cur_name << " (" << pending_entries
+                              << " entries)" << std::endl;
+                break;
+            }
+        }
+        if (f) { pump(nullptr, 0, ZSTD_e_end); fclose(f); }
+        free(out_buf);
+        ZSTD_freeCCtx(cctx);
+    }
+
+    void open_batch(int file_num) override {
+        cmds.push(WriteCmd{WriteCmd::Open, file_num, 0, std::string()});
+    }
+    void write(std::string&& data) override {
+        cmds.push(WriteCmd{WriteCmd::Data, 0, 0, std::move(data)});
+    }
+    void write_span(const char* p, size_t n) override {
+        // The encoder consumes asynchronously, so spans are always copied.
+        cmds.push(WriteCmd{WriteCmd::Data, 0, 0, std::string(p, n)});
+    }
+    void close_batch(int file_num, int entry_count) override {
+        cmds.push(WriteCmd{WriteCmd::Close, file_num, entry_count, std::string()});
+    }
+    void finish() override {
+        cmds.close();
+        if (comp.joinable()) comp.join();
+    }
+    ~ZstdBatchWriter() { finish(); }
+};
+
+#endif  // SPLIT_JSON_HAVE_ZSTD
+
+
+
+// --- UTF-8 / escape validation ----------------------------------------------
+// Downstream Python loaders choke on invalid UTF-8 or broken \uXXXX escapes,
+// which used to cost a separate full-file validation pass. --validate checks
+// every emitted span in the same pass: an 8-byte word fast path skips clean
+// ASCII stretches, non-ASCII runs through a strict UTF-8 sequence check
+// (overlongs, surrogates, > U+10FFFF), and in-string escapes are verified
+// including surrogate pairing. Offending absolute byte offsets go to a report
+// file; --validate-repair additionally patches the emitted bytes (invalid
+// UTF-8 byte -> '?', broken escape -> backslash blanked) so the output always
+// parses.
+
+struct Validator {
+    FILE* f = nullptr;
+    bool repair = false;
+    long long entries_flagged = 0;
+    long long issues = 0;
+
+    static const long long MAX_REPORT_LINES = 10000;
+
+    bool open(const std::string& path) {
+        f = fopen(path.c_str(), "w");
+        return f != nullptr;
+    }
+    void note(long long off, const char* what, unsigned detail) {
+        issues++;
+        if (f && issues <= MAX_REPORT_LINES)
+            fprintf(f, "offset %lld: %s (0x%02X)\n", off, what, detail);
+        if (f && issues == MAX_REPORT_LINES + 1)
+            fprintf(f, "... further issues suppressed\n");
+    }
+    void close() {
+        if (f) {
+            fclose(f);
+            f = nullptr;
+        }
+    }
+};
+
+static Validator* g_validate = nullptr;
+
+// Length of the valid UTF-8 sequence starting at p, or 0 if invalid.
+static int utf8_seq(const unsigned char* p, size_t avail) {
+    unsigned char c = p[0];
+    if (c < 0x80) return 1;
+    if (c < 0xC2) return 0;                                  // cont byte / overlong lead
+    if (c < 0xE0) return (avail >= 2 && (p[1] & 0xC0) == 0x80) ? 2 : 0;
+    if (c < 0xF0) {
+        if (avail < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80) return 0;
+        if (c == 0xE0 && p[1] < 0xA0) return 0;              // overlong
+        if (c == 0xED && p[1] > 0x9F) return 0;              // raw surrogate
+        return 3;
+    }
+    if (c < 0xF5) {
+        if (avail < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 ||
+            (p[3] & 0xC0) != 0x80) return 0;
+        if (c == 0xF0 && p[1] < 0x90) return 0;              // overlong
+        if (c == 0xF4 && p[1] > 0x8F) return 0;              // above U+10FFFF
+        return 4;
+    }
+    return 0;
+}
+
+static bool hex4(const char* p, unsigned* cp) {
+    unsigned v = 0;
+    for (int k = 0; k < 4; k++) {
+        char c = p[k];
+        unsigned d;
+        if (c >= '0' && c <= '9') d = (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') d = (unsigned)(c - 'a') + 10;
+        else if (c >= 'A' && c <= 'F') d = (unsigned)(c - 'A') + 10;
+        else return false;
+        v = v * 16 + d;
+    }
+    *cp = v;
+    return true;
+}
+
+// Validate one span; abs_off is its absolute input offset. With fix set the
+// issues are repaired in place and nothing is reported (second pass over an
+// already-flagged entry). Returns the issue count. For unknown escapes the
+// string tracking mirrors the scanner exactly (a backslash consumes the next
+// byte); recognized \uXXXX escapes consume their hex digits so surrogate
+// pairs can be checked as a unit.
+static long long validate_entry(const char* e, size_t n, long long abs_off,
+                                char* fix) {
+    long long bad = 0;
+    size_t i = 0;
+    bool in_str = false;
+    while (i < n) {
+        // Fast path: 8 clean ASCII bytes with no quote or backslash.
+        while (i + 8 <= n) {
+            uint64_t w;
+            memcpy(&w, e + i, 8);
+            uint64_t hit = w & 0x8080808080808080ull;
+            uint64_t xq = w ^ 0x2222222222222222ull;   // '"'
+            uint64_t xb = w ^ 0x5C5C5C5C5C5C5C5Cull;   // '\'
+            hit |= (xq - 0x0101010101010101ull) & ~xq & 0x8080808080808080ull;
+            hit |= (xb - 0x0101010101010101ull) & ~xb & 0x8080808080808080ull;
+            if (hit)
+                break;
+            i += 8;
+        }
+        if (i >= n)
+            break;
+        unsigned char c = (unsigned char)e[i];
+        if (c == '\\' && in_str) {
+            char nx = i + 1 < n ? e[i + 1] : 0;
+            if (nx == '"' || nx == '\\' || nx == '/' || nx == 'b' ||
+                nx == 'f' || nx == 'n' || nx == 'r' || nx == 't') {
+                i += 2;
+                continue;
+            }
+            unsigned cp = 0;
+            if (nx == 'u' && i + 6 <= n && hex4(e + i + 2, &cp)) {
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // High surrogate: its partner must follow immediately.
+                    unsigned lo = 0;
+                    if (i + 12 <= n && e[i + 6] == '\\' && e[i + 7] == 'u' &&
+                        hex4(e + i + 8, &lo) && lo >= 0xDC00 && lo <= 0xDFFF) {
+                        i += 12;
+                        continue;
+                    }
+                    if (fix)
+                        fix[i] = ' ';
+                    else if (g_validate)
+                        g_validate->note(abs_off + (long long)i,
+                                         "unpaired surrogate", cp & 0xFF);
+                    bad++;
+                    i += 6;            // hex digits are plain ASCII text
+                    continue;
+                }
+                if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    // Low surrogate with no preceding high.
+                    if (fix)
+                        fix[i] = ' ';
+                    else if (g_validate)
+                        g_validate->note(abs_off + (long long)i,
+                                         "unpaired surrogate", cp & 0xFF);
+                    bad++;
+                    i += 6;
+                    continue;
+                }
+                i += 6;
+                continue;
+            }
+            // Unknown escape or truncated/botched \uXXXX. Consume only the
+            // escaped byte, mirroring the scanner's string tracking.
+            if (fix)
+                fix[i] = ' ';
+            else if (g_validate)
+                g_validate->note(abs_off + (long long)i, "bad escape",
+                                 (unsigned char)nx);
+            bad++;
+            i += 2;
+            continue;
+        }
+        if (c == '"') {
+            in_str = !in_str;
+            i++;
+            continue;
+        }
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        int len = utf8_seq((const unsigned char*)e + i, n - i);
+        if (len == 0) {
+            if (fix)
+                fix[i] = '?';
+            else if (g_validate)
+                g_validate->note(abs_off + (long long)i, "invalid UTF-8", c);
+            bad++;
+            i++;
+        } else {
+            i += (size_t)len;
+        }
     }
+    return bad;
+}
+
+// --- SQLite sink ------------------------------------------------------------
+// --sqlite out.db loads entries straight into a database instead of writing
+// batch files, removing the full write+read+reparse cycle that
+// create_database.py otherwise pays over the JSON batches. Rows are
+// (instance_id, entry_json) with the raw entry bytes as the blob; inserts go
+// through one prepared statement inside a transaction that is committed and
+// reopened at every chunk rotation, with WAL journaling so readers can watch
+// progress. Compiled in when sqlite3 headers are present and
+// SPLIT_JSON_WITH_SQLITE is set (the Makefile enables it automatically).
+
+#if defined(SPLIT_JSON_WITH_SQLITE) && __has_include(<sqlite3.h>)
+#include <sqlite3.h>
+#define SPLIT_JSON_HAVE_SQLITE 1
+#endif
+
+#ifdef SPLIT_JSON_HAVE_SQLITE
 
-    std::cout << "\n\nDone! Total: " << total_entries << " entries in " << file_num << " files" << std::endl;
+struct SqliteSink {
+    sqlite3* db = nullptr;
+    sqlite3_stmt* ins = nullptr;
+    long long rows = 0;
+
+    bool open(const std::string& path) {
+        if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+            return false;
+        const char* setup =
+            "PRAGMA journal_mode=WAL;"
+            "PRAGMA synchronous=NORMAL;"
+            "CREATE TABLE IF NOT EXISTS entries ("
+            "  instance_id TEXT PRIMARY KEY,"
+            "  entry_json BLOB"
+            ");"
+            "BEGIN";
+        if (sqlite3_exec(db, setup, nullptr, nullptr, nullptr) != SQLITE_OK)
+            return false;
+        return sqlite3_prepare_v2(db,
+                   "INSERT OR REPLACE INTO entries (instance_id, entry_json) "
+                   "VALUES (?, ?)", -1, &ins, nullptr) == SQLITE_OK;
+    }
+
+    // Insert one emitted span; the key and the clean entry bytes (leading
+    // separator junk stripped) both come from the span itself.
+    bool insert(const char* e, size_t n) {
+        const char* kp;
+        size_t kn;
+        if (!span_key(e, n, &kp, &kn))
+            return false;
+        const char* body = kp - 1;             // from the key's opening quote
+        size_t blen = n - (size_t)(body - e);
+        sqlite3_bind_text(ins, 1, kp, (int)kn, SQLITE_STATIC);
+        sqlite3_bind_blob(ins, 2, body, (int)blen, SQLITE_STATIC);
+        int rc = sqlite3_step(ins);
+        sqlite3_reset(ins);
+        sqlite3_clear_bindings(ins);
+        if (rc != SQLITE_DONE)
+            return false;
+        rows++;
+        return true;
+    }
+
+    // Chunk boundary: commit the open transaction and start the next one.
+    void checkpoint_txn() {
+        sqlite3_exec(db, "COMMIT; BEGIN", nullptr, nullptr, nullptr);
+    }
+
+    void close() {
+        if (!db)
+            return;
+        if (ins)
+            sqlite3_finalize(ins);
+        sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+        sqlite3_close(db);
+        db = nullptr;
+    }
+};
+
+#endif  // SPLIT_JSON_HAVE_SQLITE
+
+#ifdef SPLIT_JSON_HAVE_SQLITE
+static SqliteSink* g_sqlite = nullptr;
+#else
+// Keeps the scan-loop hook compiled out without sprinkling more #ifdefs.
+struct SqliteSink {
+    bool insert(const char*, size_t) { return false; }
+    void checkpoint_txn() {}
+};
+static SqliteSink* g_sqlite = nullptr;
+#endif
+
+// Swallows all batch output; used when --sqlite replaces the file sink.
+struct NullBatchWriter : BatchWriter {
+    void open_batch(int) override {}
+    void write(std::string&&) override {}
+    void write_span(const char*, size_t) override {}
+    void close_batch(int, int) override {}
+    void finish() override {}
+};
+
+
+// --- Property projection ----------------------------------------------------
+// Analyses usually need one or two properties (P577, P50, ...) per entry yet
+// re-parse full entries from the batches. --project P577,... extracts the
+// listed property values with a shallow byte match while scanning -- locate
+// the "Pnnn" key, require a following colon, take the balanced value -- and
+// appends (key, minified value) TSV rows to one column file per property.
+// The match is shallow by design: a "Pnnn" string that is not a key followed
+// by a colon never matches, but a same-named key nested deeper inside the
+// entry would. For this dump's two-level properties layout that ambiguity
+// does not arise.
+
+struct Projection {
+    struct Col {
+        std::string pid;
+        std::string needle;            // "Pnnn" including the quotes
+        FILE* f = nullptr;
+        long long rows = 0;
+    };
+    std::vector<Col> cols;
+
+    bool open(const std::string& output_dir, const char* list) {
+        std::string pid;
+        for (const char* q = list;; q++) {
+            if (*q && *q != ',') {
+                pid.push_back(*q);
+                continue;
+            }
+            if (!pid.empty()) {
+                Col c;
+                c.pid = pid;
+                c.needle = "\"" + pid + "\"";
+                std::string path = output_dir + "/column_" + pid + ".tsv";
+                c.f = fopen(path.c_str(), "w");
+                if (!c.f)
+                    return false;
+                cols.push_back(c);
+                pid.clear();
+            }
+            if (!*q)
+                break;
+        }
+        return !cols.empty();
+    }
+
+    // Balanced end of the value starting at e[v] ('{' or '['); string- and
+    // escape-aware. Returns one past the closer, or n if unterminated.
+    static size_t value_end(const char* e, size_t n, size_t v) {
+        int depth = 0;
+        bool in_str = false;
+        for (size_t i = v; i < n; i++) {
+            char c = e[i];
+            if (in_str) {
+                if (c == '\\') i++;
+                else if (c == '"') in_str = false;
+                continue;
+            }
+            if (c == '"') in_str = true;
+            else if (c == '{' || c == '[') depth++;
+            else if (c == '}' || c == ']') {
+                if (--depth == 0)
+                    return i + 1;
+            }
+        }
+        return n;
+    }
+
+    void project(const char* e, size_t n) {
+        const char* kp;
+        size_t kn;
+        if (!span_key(e, n, &kp, &kn))
+            return;
+        for (size_t ci = 0; ci < cols.size(); ci++) {
+            Col& c = cols[ci];
+            const char* nd = c.needle.data();
+            size_t nl = c.needle.size();
+            for (size_t i = (size_t)(kp - e); i + nl < n;) {
+                const char* hit = (const char*)memchr(e + i, '"', n - i - nl);
+                if (!hit)
+                    break;
+                i = (size_t)(hit - e);
+                if (memcmp(e + i, nd, nl) != 0) {
+                    i++;
+                    continue;
+                }
+                size_t j = i + nl;
+                while (j < n && (e[j] == ' ' || e[j] == '\t'))
+                    j++;
+                if (j >= n || e[j] != ':') {
+                    i++;
+                    continue;
+                }
+                j++;
+                while (j < n && (e[j] == ' ' || e[j] == '\t' ||
+                                 e[j] == '\n' || e[j] == '\r'))
+                    j++;
+                if (j >= n)
+                    break;
+                size_t ve;
+                if (e[j] == '{' || e[j] == '[') {
+                    ve = value_end(e, n, j);
+                } else {
+                    ve = j;
+                    bool in_str = false;
+                    while (ve < n) {
+                        char ch = e[ve];
+                        if (in_str) {
+                            if (ch == '\\') ve++;
+                            else if (ch == '"') in_str = false;
+                        } else if (ch == '"') {
+                            in_str = true;
+                        } else if (ch == ',' || ch == '}' || ch == ']' ||
+                                   ch == '\n') {
+                            break;
+                        }
+                        ve++;
+                    }
+                }
+                std::string val;
+                append_minified(val, e + j, ve - j);
+                fwrite(kp, 1, kn, c.f);
+                fputc('\t', c.f);
+                fwrite(val.data(), 1, val.size(), c.f);
+                fputc('\n', c.f);
+                c.rows++;
+                break;                 // one value per property per entry
+            }
+        }
+    }
+
+    void close() {
+        for (size_t i = 0; i < cols.size(); i++)
+            if (cols[i].f)
+                fclose(cols[i].f);
+    }
+};
+
+static Projection* g_project = nullptr;
+
+
+// --- Dump diff --------------------------------------------------------------
+// Monthly re-extractions change under 5% of entries, yet every run re-split
+// and re-loaded the whole dump. --diff PREV_DIR loads the previous run's v2
+// index sidecars (key hash, content hash per entry), hashes each new entry
+// during the scan, and emits only added or changed entries into the delta
+// batches; keys present before but missing now are listed in
+// removed_keys.txt, recovered from the old batch bytes the index points at.
+
+struct DumpDiff {
+    struct Rec {
+        uint64_t key_hash;
+        uint64_t content_hash;
+        uint64_t offset;
+        uint64_t length;
+        int file;
+        bool seen;
+    };
+    std::vector<Rec> recs;             // sorted by key_hash
+    std::vector<std::string> files;    // batch path per Rec::file
+    long long added = 0;
+    long long changed = 0;
+    long long unchanged = 0;
+    long long removed = 0;
+
+    bool load(const std::string& prev_dir) {
+        // Same layout probing as lookup_entry: optional shard_NN fanout,
+        // default naming, both output formats.
+        int fanout = 0;
+        for (;; fanout++) {
+            char shard[384];
+            snprintf(shard, sizeof(shard), "%s/shard_%02d", prev_dir.c_str(), fanout);
+            struct stat st;
+            if (stat(shard, &st) != 0 || !S_ISDIR(st.st_mode))
+                break;
+        }
+        const char* exts[] = {"json", "ndjson"};
+        for (int file_num = 1;; file_num++) {
+            bool any = false;
+            for (const char* ext : exts) {
+                char name[512];
+                if (fanout > 0)
+                    snprintf(name, sizeof(name), "%s/shard_%02d/extracted_data_%03d.%s",
+                             prev_dir.c_str(), (file_num - 1) % fanout, file_num, ext);
+                else
+                    snprintf(name, sizeof(name), "%s/extracted_data_%03d.%s",
+                             prev_dir.c_str(), file_num, ext);
+                struct stat st;
+                if (stat(name, &st) != 0)
+                    continue;
+                any = true;
+                if (!load_idx(name))
+                    return false;
+            }
+            if (!any)
+                break;
+        }
+        std::sort(recs.begin(), recs.end(),
+                  [](const Rec& a, const Rec& b) { return a.key_hash < b.key_hash; });
+        return !recs.empty();
+    }
+
+    bool load_idx(const std::string& batch_path) {
+        std::string idx_path = batch_path + ".idx";
+        FILE* f = fopen(idx_path.c_str(), "rb");
+        if (!f) {
+            std::cerr << "Missing index sidecar " << idx_path
+                      << " (previous run needs --index)" << std::endl;
+            return false;
+        }
+        char magic[8];
+        uint64_t count = 0;
+        bool ok = fread(magic, 1, 8, f) == 8 &&
+                  memcmp(magic, IDX_MAGIC_V2, 8) == 0 &&
+                  fread(&count, 8, 1, f) == 1;
+        if (!ok) {
+            std::cerr << idx_path << " is not a v2 index; re-split the previous "
+                         "dump with --index to get content hashes" << std::endl;
+            fclose(f);
+            return false;
+        }
+        int file = (int)files.size();
+        files.push_back(batch_path);
+        for (uint64_t i = 0; i < count; i++) {
+            IdxRecord r;
+            if (fread(&r, sizeof(r), 1, f) != 1)
+                break;
+            recs.push_back(Rec{r.key_hash, r.content_hash, r.offset, r.length,
+                               file, false});
+        }
+        fclose(f);
+        return true;
+    }
+
+    // Called per emitted entry; marks the previous record seen and says
+    // whether the entry belongs in the delta.
+    bool emit(uint64_t kh, uint64_t ch) {
+        size_t lo = 0, hi = recs.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (recs[mid].key_hash < kh)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo >= recs.size() || recs[lo].key_hash != kh) {
+            added++;
+            return true;
+        }
+        recs[lo].seen = true;
+        if (recs[lo].content_hash != ch) {
+            changed++;
+            return true;
+        }
+        unchanged++;
+        return false;
+    }
+
+    // Keys that disappeared: pull each unseen record's span head back out of
+    // the old batch file and lift the key from it.
+    bool write_removed(const std::string& path) {
+        FILE* out = fopen(path.c_str(), "w");
+        if (!out)
+            return false;
+        for (size_t i = 0; i < recs.size(); i++) {
+            if (recs[i].seen)
+                continue;
+            FILE* bf = fopen(files[recs[i].file].c_str(), "rb");
+            if (!bf)
+                continue;
+            char head[512];
+            size_t want = recs[i].length < sizeof(head) ? recs[i].length
+                                                        : sizeof(head);
+            size_t got = 0;
+            if (fseek(bf, (long)recs[i].offset, SEEK_SET) == 0)
+                got = fread(head, 1, want, bf);
+            fclose(bf);
+            const char* kp;
+            size_t kn;
+            if (got > 0 && span_key(head, got, &kp, &kn)) {
+                fwrite(kp, 1, kn, out);
+                fputc('\n', out);
+                removed++;
+            }
+        }
+        fclose(out);
+        return true;
+    }
+};
+
+static DumpDiff* g_diff = nullptr;
+
+// --- Entry-boundary scan ----------------------------------------------------
+
+
+
+// --- Malformed-input recovery -----------------------------------------------
+// The SPARQL extraction occasionally emits truncated or concatenated JSON and
+// the splitter would silently derail on it: one bad brace and every later
+// "entry" is garbage. --recover validates each emitted span's basic shape
+// ("KEY": { ... }), resynchronizes to the next plausible top-level key when a
+// span fails, and survives premature or stray outer closes instead of
+// treating them as end-of-file. Rejected bytes go to a quarantine file with
+// their absolute input offsets so a repair pass can inspect exactly what was
+// dropped.
+
+struct Quarantine {
+    FILE* f = nullptr;
+    long long spans = 0;
+    long long bytes = 0;
+
+    bool open(const std::string& path) {
+        f = fopen(path.c_str(), "w");
+        return f != nullptr;
+    }
+    void put(long long off, const char* p, size_t n) {
+        if (!f || n == 0)
+            return;
+        fprintf(f, "--- offset %lld length %zu\n", off, (size_t)n);
+        fwrite(p, 1, n, f);
+        fputc('\n', f);
+        spans++;
+        bytes += (long long)n;
+    }
+    void close() {
+        if (f) {
+            fclose(f);
+            f = nullptr;
+        }
+    }
+};
+
+// Non-null while --recover is active.
+static Quarantine* g_quarantine = nullptr;
+
+// --- Bounded-memory guardrails ----------------------------------------------
+// Some entities carry thousands of statements; the old split_json.c wrote
+// them into a fixed 128 KB entry_buf with an unchecked entry_pos++, and the
+// std::string carry here would just balloon. --max-entry-bytes caps what the
+// scan will hold: an entry over the cap is streamed in chunks into
+// <output_dir>/large_entries.json as the blocks arrive (policy "spill",
+// the default) or dropped (policy "skip"); either way its input offset and
+// length are logged to oversize_offsets.txt and the carry never grows past
+// the cap, so peak RSS is flat no matter what shape the dump is.
+
+struct Oversize {
+    long long cap = 0;
+    bool skip = false;             // "skip" policy: log and drop, no spill file
+    FILE* f = nullptr;
+    FILE* log = nullptr;
+    long long entries = 0;
+    long long bytes = 0;
+
+    bool open(const std::string& output_dir) {
+        log = fopen((output_dir + "/oversize_offsets.txt").c_str(), "w");
+        if (!log)
+            return false;
+        if (!skip) {
+            f = fopen((output_dir + "/large_entries.json").c_str(), "w");
+            if (!f)
+                return false;
+        }
+        return true;
+    }
+    void spill(const char* p, size_t n) {
+        if (f)
+            fwrite(p, 1, n, f);
+    }
+    // One entry fully handled: newline-separate spilled entries, log it.
+    void end_entry(long long off, long long len) {
+        if (f)
+            fputc('\n', f);
+        fprintf(log, "%lld %lld\n", off, len);
+        entries++;
+        bytes += len;
+    }
+    void close() {
+        if (f) fclose(f);
+        if (log) fclose(log);
+        f = nullptr;
+        log = nullptr;
+    }
+};
+
+// Non-null while --max-entry-bytes is active.
+static Oversize* g_oversize = nullptr;
+
+// Length of the leading comma/whitespace junk ahead of an entry's key.
+static size_t separator_prefix(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && (p[i] == ',' || p[i] == '\n' || p[i] == '\r' ||
+                     p[i] == ' ' || p[i] == '\t'))
+        i++;
+    return i;
+}
+
+// Separator junk between entries: commas and whitespace.
+static bool all_separator(const char* p, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        if (p[i] != ',' && p[i] != '\n' && p[i] != '\r' &&
+            p[i] != ' ' && p[i] != '\t')
+            return false;
+    return true;
+}
+
+// Structural plausibility of a span: after the usual separator junk it must
+// read "KEY": { ... } with the closing brace as its final byte. Returns the
+// offset of the opening key quote, scanning forward past garbage to the next
+// plausible key if needed; -1 when the span holds no plausible entry.
+// *sep_end gets the offset of the first non-separator byte.
+static long long entry_resync(const char* e, size_t n, long long* sep_end) {
+    size_t i = 0;
+    while (i < n && (e[i] == ',' || e[i] == '\n' || e[i] == '\r' ||
+                     e[i] == ' ' || e[i] == '\t'))
+        i++;
+    *sep_end = (long long)i;
+    if (n == 0 || e[n - 1] != '}')
+        return -1;
+    while (i < n) {
+        const char* q = (const char*)memchr(e + i, '"', n - i);
+        if (!q)
+            return -1;
+        size_t k = (size_t)(q - e) + 1;
+        size_t kend = k;
+        while (kend < n && kend - k < 256 && e[kend] != '"' && e[kend] != '\\')
+            kend++;
+        if (kend < n && e[kend] == '"') {
+            size_t j = kend + 1;
+            while (j < n && (e[j] == ' ' || e[j] == '\t'))
+                j++;
+            if (j < n && e[j] == ':') {
+                j++;
+                while (j < n && (e[j] == ' ' || e[j] == '\t' ||
+                                 e[j] == '\n' || e[j] == '\r'))
+                    j++;
+                if (j < n && e[j] == '{')
+                    return (long long)(q - e);
+            }
+        }
+        i = (size_t)(q - e) + 1;
+    }
+    return -1;
+}
+
+// --- Streaming statistics ---------------------------------------------------
+// --stats piggybacks on the entry boundaries the scan finds anyway and
+// accumulates size/depth distributions plus per-batch totals, then writes a
+// JSON report next to the batches. Replaces the re-read-everything-in-Python
+// passes of analyze_database.py for the common questions.
+
+struct SplitStats {
+    long long count = 0;
+    long long total_bytes = 0;
+    long long min_bytes = -1;
+    long long max_bytes = 0;
+    long long size_hist[48] = {0};    // bucket k: entries with size < 2^(k+1)
+    long long depth_hist[64] = {0};   // per-entry max brace depth
+    int max_depth = 0;
+
+    struct Batch {
+        std::string file;
+        long long entries;
+        long long bytes;
+    };
+    std::vector<Batch> batches;
+
+    void add_entry(long long bytes, int depth) {
+        count++;
+        total_bytes += bytes;
+        if (min_bytes < 0 || bytes < min_bytes) min_bytes = bytes;
+        if (bytes > max_bytes) max_bytes = bytes;
+        int b = 0;
+        while (b < 47 && (1ll << (b + 1)) <= bytes) b++;
+        size_hist[b]++;
+        if (depth > 63) depth = 63;
+        depth_hist[depth]++;
+        if (depth > max_depth) max_depth = depth;
+    }
+
+    void add_batch(const std::string& file, long long entries, long long bytes) {
+        batches.push_back(Batch{file, entries, bytes});
+    }
+
+    bool write_report(const std::string& path, long long input_bytes,
+                      long long filtered_out) const {
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        fprintf(f, "{\n");
+        fprintf(f, "  \"input_bytes\": %lld,\n", input_bytes);
+        fprintf(f, "  \"entries\": %lld,\n", count);
+        fprintf(f, "  \"filtered_out\": %lld,\n", filtered_out);
+        fprintf(f, "  \"entry_bytes\": {\"min\": %lld, \"max\": %lld, "
+                   "\"mean\": %.1f, \"total\": %lld},\n",
+                min_bytes < 0 ? 0 : min_bytes, max_bytes,
+                count ? (double)total_bytes / (double)count : 0.0, total_bytes);
+        fprintf(f, "  \"max_depth\": %d,\n", max_depth);
+        fprintf(f, "  \"size_histogram\": [");
+        bool first = true;
+        for (int b = 0; b < 48; b++) {
+            if (!size_hist[b]) continue;
+            fprintf(f, "%s\n    {\"lt\": %lld, \"count\": %lld}",
+                    first ? "" : ",", 1ll << (b + 1), size_hist[b]);
+            first = false;
+        }
+        fprintf(f, "\n  ],\n");
+        fprintf(f, "  \"depth_histogram\": [");
+        first = true;
+        for (int d = 0; d < 64; d++) {
+            if (!depth_hist[d]) continue;
+            fprintf(f, "%s\n    {\"depth\": %d, \"count\": %lld}",
+                    first ? "" : ",", d, depth_hist[d]);
+            first = false;
+        }
+        fprintf(f, "\n  ],\n");
+        fprintf(f, "  \"batches\": [");
+        for (size_t i = 0; i < batches.size(); i++)
+            fprintf(f, "%s\n    {\"file\": \"%s\", \"entries\": %lld, \"bytes\": %lld}",
+                    i ? "," : "", batches[i].file.c_str(),
+                    batches[i].entries, batches[i].bytes);
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+        return true;
+    }
+};
+
+// Non-null while --stats is active; checked on the entry path only.
+static SplitStats* g_stats = nullptr;
+
+
+// --- Hot-path profiling -----------------------------------------------------
+// When split throughput regresses the only signal used to be wall-clock time.
+// --profile attributes cycles to the three pipeline stages (read, scan,
+// write), counts structural vs in-string bytes, keeps an entry-size
+// histogram, and pulls branch/instruction counters from perf_event_open
+// where the kernel allows it; everything lands in
+// <output_dir>/split_profile.json at exit. Instrumentation is pointer-gated
+// like the other per-entry features, so the default path only pays for a
+// handful of predictable branches.
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#define SPLIT_JSON_HAVE_PERF 1
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+
+// Timestamp-counter read; falls back to clock_gettime nanoseconds on
+// architectures without a cheap user-space counter.
+static inline uint64_t prof_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+struct Profile {
+    uint64_t read_ticks = 0;       // blocked on input
+    uint64_t write_ticks = 0;      // entry emission, sinks, rotation
+    uint64_t scan_ticks = 0;       // everything else inside the loop
+    uint64_t total_ticks = 0;
+    long long structural_bytes = 0;
+    long long string_bytes = 0;
+    long long input_bytes = 0;
+    long long entries = 0;
+    long long size_hist[48] = {0}; // entry bytes, power-of-2 buckets
+    double wall_sec = 0;
+    struct timespec wall0 = {0, 0};
+
+#ifdef SPLIT_JSON_HAVE_PERF
+    // One group: cycles, instructions, branches, branch misses.
+    int perf_fds[4] = {-1, -1, -1, -1};
+    uint64_t perf_vals[4] = {0, 0, 0, 0};
+    bool perf_ok = false;
+
+    static int perf_open(uint32_t type, uint64_t config, int group) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = (group == -1) ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    }
+#endif
+
+    void start() {
+        clock_gettime(CLOCK_MONOTONIC, &wall0);
+        total_ticks = prof_ticks();
+#ifdef SPLIT_JSON_HAVE_PERF
+        static const uint64_t configs[4] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES};
+        perf_fds[0] = perf_open(PERF_TYPE_HARDWARE, configs[0], -1);
+        if (perf_fds[0] >= 0) {
+            perf_ok = true;
+            for (int i = 1; i < 4; i++)
+                perf_fds[i] = perf_open(PERF_TYPE_HARDWARE, configs[i], perf_fds[0]);
+            ioctl(perf_fds[0], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop() {
+        total_ticks = prof_ticks() - total_ticks;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        wall_sec = (now.tv_sec - wall0.tv_sec) + (now.tv_nsec - wall0.tv_nsec) / 1e9;
+        uint64_t attributed = read_ticks + write_ticks;
+        scan_ticks = total_ticks > attributed ? total_ticks - attributed : 0;
+#ifdef SPLIT_JSON_HAVE_PERF
+        if (perf_ok) {
+            ioctl(perf_fds[0], PERF_EVENT_IOC_DISABLE, 0);
+            for (int i = 0; i < 4; i++) {
+                if (perf_fds[i] < 0 ||
+                    read(perf_fds[i], &perf_vals[i], 8) != 8)
+                    perf_vals[i] = 0;
+                if (perf_fds[i] >= 0)
+                    close(perf_fds[i]);
+            }
+        }
+#endif
+    }
+
+    void add_entry(long long bytes) {
+        entries++;
+        int b = 0;
+        while ((1ll << (b + 1)) < bytes && b < 47)
+            b++;
+        size_hist[b]++;
+    }
+
+    // Upper bucket bound below which `pct` percent of entries fall.
+    long long percentile(double pct) const {
+        long long need = (long long)(entries * pct / 100.0);
+        long long seen = 0;
+        for (int b = 0; b < 48; b++) {
+            seen += size_hist[b];
+            if (seen >= need && size_hist[b])
+                return 1ll << (b + 1);
+        }
+        return 0;
+    }
+
+    bool write_report(const std::string& path) {
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        double per_byte = input_bytes > 0 ? (double)input_bytes : 1.0;
+        fprintf(f, "{\n");
+        fprintf(f, "  \"wall_seconds\": %.3f,\n", wall_sec);
+        fprintf(f, "  \"input_bytes\": %lld,\n", input_bytes);
+        fprintf(f, "  \"entries\": %lld,\n", entries);
+        fprintf(f, "  \"stages\": {\n");
+        fprintf(f, "    \"read\":  {\"ticks\": %llu, \"ticks_per_byte\": %.3f},\n",
+                (unsigned long long)read_ticks, read_ticks / per_byte);
+        fprintf(f, "    \"scan\":  {\"ticks\": %llu, \"ticks_per_byte\": %.3f},\n",
+                (unsigned long long)scan_ticks, scan_ticks / per_byte);
+        fprintf(f, "    \"write\": {\"ticks\": %llu, \"ticks_per_byte\": %.3f}\n",
+                (unsigned long long)write_ticks, write_ticks / per_byte);
+        fprintf(f, "  },\n");
+        fprintf(f, "  \"byte_classes\": {\n");
+        fprintf(f, "    \"structural\": %lld,\n", structural_bytes);
+        fprintf(f, "    \"in_string\": %lld,\n", string_bytes);
+        fprintf(f, "    \"structural_ratio\": %.4f,\n", structural_bytes / per_byte);
+        fprintf(f, "    \"in_string_ratio\": %.4f\n", string_bytes / per_byte);
+        fprintf(f, "  },\n");
+#ifdef SPLIT_JSON_HAVE_PERF
+        if (perf_ok) {
+            fprintf(f, "  \"perf\": {\n");
+            fprintf(f, "    \"cycles\": %llu,\n", (unsigned long long)perf_vals[0]);
+            fprintf(f, "    \"instructions\": %llu,\n", (unsigned long long)perf_vals[1]);
+            fprintf(f, "    \"branches\": %llu,\n", (unsigned long long)perf_vals[2]);
+            fprintf(f, "    \"branch_misses\": %llu,\n", (unsigned long long)perf_vals[3]);
+            fprintf(f, "    \"branch_miss_rate\": %.5f,\n",
+                    perf_vals[2] ? (double)perf_vals[3] / perf_vals[2] : 0.0);
+            fprintf(f, "    \"cycles_per_byte\": %.3f\n", perf_vals[0] / per_byte);
+            fprintf(f, "  },\n");
+        }
+#endif
+        fprintf(f, "  \"entry_size_percentiles\": {\"p50_lt\": %lld, \"p90_lt\": %lld, \"p99_lt\": %lld},\n",
+                percentile(50), percentile(90), percentile(99));
+        fprintf(f, "  \"entry_size_histogram\": [");
+        bool first = true;
+        for (int b = 0; b < 48; b++) {
+            if (!size_hist[b]) continue;
+            fprintf(f, "%s\n    {\"lt\": %lld, \"count\": %lld}",
+                    first ? "" : ",", 1ll << (b + 1), size_hist[b]);
+            first = false;
+        }
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+        return true;
+    }
+};
+
+// Non-null while --profile is active.
+static Profile* g_profile = nullptr;
+
+// Adds the scope's elapsed ticks to an accumulator on every exit path
+// (the emission branch leaves through several continues).
+struct ProfScope {
+    uint64_t* acc;
+    uint64_t t0;
+    explicit ProfScope(uint64_t* a) : acc(a), t0(a ? prof_ticks() : 0) {}
+    ~ProfScope() {
+        if (acc)
+            *acc += prof_ticks() - t0;
+    }
+};
+
+struct SplitResult {
+    long long total_entries = 0;
+    long long filtered_out = 0;
+    int file_num = 1;
+};
+
+// Periodic scan-state snapshots so an interrupted 20-minute split restarts in
+// seconds instead of from scratch. Checkpoints are only taken right after a
+// top-level entry boundary, where the state is tiny: depth is 1, we are not
+// inside a string, and the next entry starts at the very next byte.
+struct Checkpointing {
+    std::string path;              // empty = disabled
+    int interval_sec = 5;
+};
+
+struct ScanResume {
+    bool active = false;
+    long long pos = 0;             // input offset to continue scanning at
+    int file_num = 1;
+    int entry_count = 0;
+    long long total_entries = 0;
+    bool first_in_file = true;
+    long long out_bytes = 0;       // known-good size of the open batch file
+};
+
+static bool write_checkpoint(const std::string& path, long long pos, int file_num,
+                             int entry_count, long long total, bool first_in_file,
+                             long long out_bytes) {
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "split_json checkpoint v1\n");
+    fprintf(f, "pos=%lld\nbrace_depth=1\nin_string=0\n", pos);
+    fprintf(f, "file_num=%d\nentry_count=%d\ntotal_entries=%lld\n",
+            file_num, entry_count, total);
+    fprintf(f, "first_in_file=%d\nout_bytes=%lld\n", first_in_file ? 1 : 0, out_bytes);
+    fclose(f);
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+static bool read_checkpoint(const std::string& path, ScanResume& r) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char line[256];
+    if (!fgets(line, sizeof(line), f) ||
+        strncmp(line, "split_json checkpoint v1", 24) != 0) {
+        fclose(f);
+        return false;
+    }
+    int first = 1;
+    while (fgets(line, sizeof(line), f)) {
+        long long v;
+        if (sscanf(line, "pos=%lld", &v) == 1) r.pos = v;
+        else if (sscanf(line, "file_num=%lld", &v) == 1) r.file_num = (int)v;
+        else if (sscanf(line, "entry_count=%lld", &v) == 1) r.entry_count = (int)v;
+        else if (sscanf(line, "total_entries=%lld", &v) == 1) r.total_entries = v;
+        else if (sscanf(line, "first_in_file=%lld", &v) == 1) first = (int)v;
+        else if (sscanf(line, "out_bytes=%lld", &v) == 1) r.out_bytes = v;
+    }
+    fclose(f);
+    r.first_in_file = (first != 0);
+    r.active = true;
+    return true;
+}
+
+static SplitResult scan_split(BlockProvider& src, BatchWriter& sink, long long file_size,
+                              const std::string& output_dir,
+                              const Checkpointing& ckpt = Checkpointing(),
+                              const ScanResume& resume = ScanResume(),
+                              ProgressReporter* prog = nullptr) {
+    SplitResult res;
+
+    int entry_count = 0;
+    int brace_depth = 0;
+    bool in_string = false;
+    bool found_start = false;
+    long long esc_pos = -1;        // absolute position of an escaped byte, or -1
+    long long bytes_read = 0;      // absolute position of the current window start
+    time_t last_ckpt = time(nullptr);
+    (void)file_size;
+
+    const char* scanner_name;
+    structural_fn structural_bits = select_structural_fn(&scanner_name);
+    (void)scanner_name;
+
+    // Offset of the next write inside the current batch file, and the index
+    // records collected for it (--index).
+    long long out_off = (g_format == FMT_WRAPPED) ? 2 : 0;
+    std::vector<IdxRecord> idx;
+
+    bool first_in_file = true;
+    if (resume.active) {
+        res.file_num = resume.file_num;
+        res.total_entries = resume.total_entries;
+        entry_count = resume.entry_count;
+        first_in_file = resume.first_in_file;
+        found_start = true;
+        brace_depth = 1;
+        bytes_read = resume.pos;
+        out_off = resume.out_bytes;
+    } else {
+        sink.open_batch(res.file_num);
+        if (g_format == FMT_WRAPPED)
+            sink.write("{\n");
+    }
+
+    // Entries are contiguous in the input, so only their [start, end] offsets
+    // are tracked and each one goes out as a single bulk write. The carry
+    // buffer is used only when a span crosses a recycled read buffer; on the
+    // mmap path no entry byte is ever copied.
+    const bool stable = src.stable();
+    long long span_start = resume.active ? resume.pos : -1;   // absolute offset of the open entry
+    int entry_max_depth = 1;       // nesting depth of the open entry (--stats)
+    bool oversize_active = false;  // open entry already spilling past the cap
+    std::string carry;
+    carry.reserve(50 * 1024);
+
+    const char* block;
+    size_t block_len;
+    long long block_start = 0;     // absolute offset of the current block
+    bool done = false;
+
+    // Materialize the open span [span_start, upto] without emitting it; used
+    // by --recover when a region is quarantined instead of written.
+    auto span_bytes = [&](long long upto, const char** sp, size_t* sn) {
+        if (!carry.empty()) {
+            long long from = span_start > block_start ? span_start : block_start;
+            if (upto >= from)
+                carry.append(block + (from - block_start),
+                             (size_t)(upto - from + 1));
+            *sp = carry.data();
+            *sn = carry.size();
+        } else if (upto >= span_start) {
+            *sp = block + (span_start - block_start);
+            *sn = (size_t)(upto - span_start + 1);
+        } else {
+            *sp = nullptr;
+            *sn = 0;
+        }
+    };
+
+    if (g_profile)
+        g_profile->start();
+    long long prof_str_open = -1;  // input offset of the open string (--profile)
+
+    while (!done) {
+        {
+            ProfScope rd(g_profile ? &g_profile->read_ticks : nullptr);
+            if (!src.next_block(&block, &block_len))
+                break;
+        }
+        block_start = bytes_read;
+        size_t off = 0;
+        while (off < block_len && !done) {
+            // One 64-byte window per iteration; the tail is zero-padded so the
+            // same bitmap path handles it (padding bytes are never structural).
+            const char* w = block + off;
+            size_t wlen = block_len - off;
+            char tail[64];
+            if (wlen >= 64) {
+                wlen = 64;
+            } else {
+                memset(tail, 0, sizeof(tail));
+                memcpy(tail, w, wlen);
+                w = tail;
+            }
+
+            uint64_t bits = structural_bits(w);
+            if (wlen < 64)
+                bits &= (1ULL << wlen) - 1;
+            if (g_profile)
+                g_profile->structural_bytes += __builtin_popcountll(bits);
+
+            while (bits) {
+                size_t i = (size_t)__builtin_ctzll(bits);
+                bits &= bits - 1;
+                char c = w[i];
+                long long pos = bytes_read + (long long)i;
+
+                if (!found_start) {
+                    if (c == '{') {
+                        found_start = true;
+                        brace_depth = 1;
+                        span_start = pos + 1;
+                    }
+                    continue;
+                }
+
+                // A byte escaped by a preceding backslash is plain content.
+                if (in_string && pos == esc_pos)
+                    continue;
+
+                if (c == '\\') {
+                    if (in_string)
+                        esc_pos = pos + 1;
+                    continue;
+                }
+
+                if (c == '"') {
+                    if (g_profile) {
+                        if (!in_string)
+                            prof_str_open = pos;
+                        else if (prof_str_open >= 0)
+                            g_profile->string_bytes += pos - prof_str_open + 1;
+                    }
+                    in_string = !in_string;
+                    continue;
+                }
+
+                if (in_string)
+                    continue;
+
+                // Track braces outside strings
+                if (c == '{') {
+                    brace_depth++;
+                    if (g_stats && brace_depth - 1 > entry_max_depth)
+                        entry_max_depth = brace_depth - 1;
+                    if (g_quarantine && brace_depth == 1) {
+                        // The outer object reopened after a premature close
+                        // (concatenated dump); junk in between is rejected.
+                        const char* sp;
+                        size_t sn;
+                        span_bytes(pos - 1, &sp, &sn);
+                        if (sn > 0 && !all_separator(sp, sn))
+                            g_quarantine->put(span_start, sp, sn);
+                        carry.clear();
+                        span_start = pos + 1;
+                        entry_max_depth = 1;
+                    }
+                } else if (c == '}') {
+                    brace_depth--;
+                    if (g_quarantine && brace_depth < 0)
+                        brace_depth = 0;   // stray close outside the object
+
+                    // Completed a top-level entry (depth back to 1)
+                    if (brace_depth == 1) {
+                        // Charged to the write stage on every exit path out
+                        // of this branch.
+                        ProfScope emit_prof(g_profile ? &g_profile->write_ticks
+                                                      : nullptr);
+
+                        // An entry already spilling past the cap: stream out
+                        // the tail still in this block and move on.
+                        if (oversize_active) {
+                            long long from = span_start > block_start
+                                                 ? span_start : block_start;
+                            g_oversize->spill(block + (from - block_start),
+                                              (size_t)(pos - from + 1));
+                            g_oversize->end_entry(span_start,
+                                                  pos - span_start + 1);
+                            oversize_active = false;
+                            carry.clear();
+                            span_start = pos + 1;
+                            entry_max_depth = 1;
+                            continue;
+                        }
+
+                        // Assemble [span_start, pos] first: one raw write, or
+                        // one NDJSON record built from the same span.
+                        const char* e;
+                        size_t elen;
+                        bool from_carry = !carry.empty();
+                        if (!from_carry) {
+                            e = block + (span_start - block_start);
+                            elen = (size_t)(pos - span_start + 1);
+                        } else {
+                            long long from = span_start > block_start ? span_start : block_start;
+                            carry.append(block + (from - block_start),
+                                         (size_t)(pos - from + 1));
+                            e = carry.data();
+                            elen = carry.size();
+                        }
+                        if (g_profile)
+                            g_profile->add_entry((long long)elen);
+
+                        // Entry over the memory cap but resident anyway
+                        // (mmap path, or it fit inside one block): divert it
+                        // whole so batches never carry oversized entries.
+                        if (g_oversize && (long long)elen > g_oversize->cap) {
+                            size_t sk = separator_prefix(e, elen);
+                            g_oversize->spill(e + sk, elen - sk);
+                            g_oversize->end_entry(span_start, (long long)elen);
+                            carry.clear();
+                            span_start = pos + 1;
+                            entry_max_depth = 1;
+                            continue;
+                        }
+
+                        // --recover: reject spans with no plausible entry,
+                        // or trim leading garbage up to the next one.
+                        if (g_quarantine) {
+                            long long sep_end = 0;
+                            long long r = entry_resync(e, elen, &sep_end);
+                            if (r < 0) {
+                                g_quarantine->put(span_start, e, elen);
+                                carry.clear();
+                                span_start = pos + 1;
+                                entry_max_depth = 1;
+                                continue;
+                            }
+                            if (r > sep_end) {
+                                g_quarantine->put(span_start, e, (size_t)r);
+                                if (from_carry) {
+                                    carry.erase(0, (size_t)r);
+                                    e = carry.data();
+                                    elen = carry.size();
+                                } else {
+                                    e += r;
+                                    elen -= (size_t)r;
+                                }
+                            }
+                        }
+
+                        // --validate: report per-entry issues; with repair,
+                        // patch a private copy and emit that instead (span
+                        // pointers must stay untouched for async sinks).
+                        if (g_validate &&
+                            validate_entry(e, elen, span_start, nullptr) > 0) {
+                            g_validate->entries_flagged++;
+                            if (g_validate->repair) {
+                                if (!from_carry) {
+                                    carry.assign(e, elen);
+                                    from_carry = true;
+                                }
+                                validate_entry(carry.data(), carry.size(),
+                                               span_start, &carry[0]);
+                                e = carry.data();
+                                elen = carry.size();
+                            }
+                        }
+
+                        // Drop filtered-out entries before any separator or
+                        // sink traffic.
+                        if (!g_filter_keys.empty() && !filter_match(e, elen)) {
+                            carry.clear();
+                            span_start = pos + 1;
+                            res.filtered_out++;
+                            entry_max_depth = 1;
+                            continue;
+                        }
+
+                        // --diff: only additions and content changes make
+                        // it into the delta.
+                        if (g_diff) {
+                            const char* kp;
+                            size_t kn;
+                            if (span_key(e, elen, &kp, &kn) &&
+                                !g_diff->emit(key_hash64(kp, kn),
+                                              key_hash64(kp - 1,
+                                                         elen - (size_t)(kp - 1 - e)))) {
+                                carry.clear();
+                                span_start = pos + 1;
+                                entry_max_depth = 1;
+                                continue;
+                            }
+                        }
+
+                        if (g_stats) {
+                            g_stats->add_entry((long long)elen, entry_max_depth);
+                            entry_max_depth = 1;
+                        }
+
+                        if (g_sqlite)
+                            g_sqlite->insert(e, elen);
+
+                        if (g_project)
+                            g_project->project(e, elen);
+
+                        if (g_format == FMT_WRAPPED && !first_in_file) {
+                            sink.write(",\n");
+                            out_off += 2;
+                        }
+                        first_in_file = false;
+
+                        uint64_t kh = 0;
+                        uint64_t chash = 0;
+                        bool have_key = false;
+                        if (g_index) {
+                            const char* kp;
+                            size_t kn;
+                            if (span_key(e, elen, &kp, &kn)) {
+                                kh = key_hash64(kp, kn);
+                                chash = key_hash64(kp - 1,
+                                                   elen - (size_t)(kp - 1 - e));
+                                have_key = true;
+                            }
+                        }
+
+                        long long emitted = (long long)elen;
+                        if (g_format == FMT_NDJSON) {
+                            std::string line = ndjson_record(e, elen);
+                            emitted = (long long)line.size();
+                            sink.write(std::move(line));
+                            carry.clear();
+                        } else if (from_carry) {
+                            sink.write(std::move(carry));
+                            carry.clear();
+                        } else {
+                            sink.write_span(e, elen);
+                        }
+
+                        if (have_key)
+                            idx.push_back(IdxRecord{kh, (uint64_t)out_off,
+                                                    (uint64_t)emitted, chash});
+                        out_off += emitted;
+                        span_start = pos + 1;
+
+                        entry_count++;
+                        res.total_entries++;
+
+                        // Check if need new file
+                        if (entry_count >= g_chunk_size ||
+                            (g_target_bytes > 0 && out_off >= g_target_bytes)) {
+                            if (g_sqlite)
+                                g_sqlite->checkpoint_txn();
+                            if (g_format == FMT_WRAPPED)
+                                sink.write("\n}");
+                            sink.close_batch(res.file_num, entry_count);
+                            if (g_stats)
+                                g_stats->add_batch(batch_filename(output_dir, res.file_num),
+                                                   entry_count,
+                                                   out_off + (g_format == FMT_WRAPPED ? 2 : 0));
+                            if (g_index) {
+                                write_index(batch_filename(output_dir, res.file_num), idx);
+                                idx.clear();
+                            }
+
+                            res.file_num++;
+                            entry_count = 0;
+                            sink.open_batch(res.file_num);
+                            if (g_format == FMT_WRAPPED)
+                                sink.write("{\n");
+                            first_in_file = true;
+                            out_off = (g_format == FMT_WRAPPED) ? 2 : 0;
+                        }
+
+                        // Periodic checkpoint, always at an entry boundary.
+                        if (!ckpt.path.empty() &&
+                            time(nullptr) - last_ckpt >= ckpt.interval_sec) {
+                            sink.sync_batch();
+                            long long ob = sink.batch_bytes();
+                            if (ob >= 0 &&
+                                write_checkpoint(ckpt.path, pos + 1, res.file_num,
+                                                 entry_count, res.total_entries,
+                                                 first_in_file, ob))
+                                last_ckpt = time(nullptr);
+                        }
+                    } else if (brace_depth == 0) {
+                        if (!g_quarantine) {
+                            // End of file
+                            done = true;
+                            break;
+                        }
+                        // --recover: a depth-0 close mid-stream is either the
+                        // real end of the dump or a stray brace; keep
+                        // scanning either way and quarantine any junk sitting
+                        // before the close. A later '{' reopens the object.
+                        const char* sp;
+                        size_t sn;
+                        span_bytes(pos, &sp, &sn);
+                        if (sn > 0 && !all_separator(sp, sn - 1))
+                            g_quarantine->put(span_start, sp, sn);
+                        carry.clear();
+                        span_start = pos + 1;
+                        entry_max_depth = 1;
+                    }
+                }
+            }
+
+            bytes_read += (long long)wlen;
+            off += wlen;
+        }
+
+        // Publish plain counters; the ticker thread does all the math.
+        if (prog) {
+            prog->bytes.store(bytes_read, std::memory_order_relaxed);
+            prog->entries.store(res.total_entries, std::memory_order_relaxed);
+            prog->file_num.store(res.file_num, std::memory_order_relaxed);
+        }
+
+        // This buffer is about to be recycled: save the open span's bytes.
+        if (!stable && !done && found_start) {
+            long long from = span_start > block_start ? span_start : block_start;
+            const char* part = block + (from - block_start);
+            size_t plen = (size_t)(block_start + (long long)block_len - from);
+            if (g_oversize &&
+                (oversize_active ||
+                 carry.size() + plen > (size_t)g_oversize->cap)) {
+                // Cap hit: everything buffered so far (and every later
+                // block's share) goes straight to the spill file, so the
+                // carry never grows past the cap.
+                if (!oversize_active) {
+                    oversize_active = true;
+                    if (!carry.empty()) {
+                        size_t sk = separator_prefix(carry.data(), carry.size());
+                        g_oversize->spill(carry.data() + sk, carry.size() - sk);
+                        carry.clear();
+                    } else {
+                        size_t sk = separator_prefix(part, plen);
+                        part += sk;
+                        plen -= sk;
+                    }
+                }
+                g_oversize->spill(part, plen);
+            } else {
+                carry.append(part, plen);
+            }
+        }
+    }
+
+    if (g_profile) {
+        g_profile->stop();
+        g_profile->input_bytes = bytes_read;
+    }
+
+    // Input ended mid-spill (truncated dump): close out the record so the
+    // spill file and offset log stay consistent.
+    if (oversize_active)
+        g_oversize->end_entry(span_start, bytes_read - span_start);
+
+    // --recover: whatever is still open or trailing at the end of input --
+    // an unterminated entry, or junk after the outer close -- is quarantined.
+    if (g_quarantine && found_start && span_start >= 0) {
+        const char* sp = nullptr;
+        size_t sn = 0;
+        if (!carry.empty()) {
+            sp = carry.data();
+            sn = carry.size();
+        } else if (stable && bytes_read > span_start) {
+            sp = block + (span_start - block_start);
+            sn = (size_t)(bytes_read - span_start);
+        }
+        if (sn > 0 && !(brace_depth <= 0 && all_separator(sp, sn)))
+            g_quarantine->put(span_start, sp, sn);
+    }
+
+    // Write remaining
+    if (entry_count > 0) {
+        if (g_format == FMT_WRAPPED)
+            sink.write("\n}");
+        sink.close_batch(res.file_num, entry_count);
+        if (g_stats)
+            g_stats->add_batch(batch_filename(output_dir, res.file_num), entry_count,
+                               out_off + (g_format == FMT_WRAPPED ? 2 : 0));
+        if (g_index) {
+            write_index(batch_filename(output_dir, res.file_num), idx);
+            idx.clear();
+        }
+    }
+    sink.finish();
+
+    return res;
+}
+
+// --- Parallel range split ---------------------------------------------------
+// Speculative two-pass parse over the mmap'd file: the input is cut into one
+// byte range per thread, pass 1 computes each range's transfer function for
+// the scan state (in-string / escape / brace-depth delta) under every possible
+// starting state, a cheap sequential composition then pins down the true state
+// at each range start, and pass 2 re-scans the ranges in parallel with known
+// state to collect the exact top-level entry boundaries. Batch files are
+// finally written in parallel straight from the mapping, byte-identical to a
+// sequential run.
+
+// Scan states at a range boundary: outside a string, inside a string, or
+// inside a string with the first byte escaped by a trailing backslash.
+enum { ST_OUT = 0, ST_IN = 1, ST_IN_ESC = 2 };
+
+struct RangeTransfer {
+    int end_state[3];
+    long long depth_delta[3];
+};
+
+static RangeTransfer range_transfer(const char* base, long long lo, long long hi,
+                                    structural_fn structural_bits) {
+    bool in_string[3] = {false, true, true};
+    long long esc_pos[3] = {-1, -1, lo};
+    long long delta[3] = {0, 0, 0};
+
+    long long off = lo;
+    while (off < hi) {
+        const char* w = base + off;
+        size_t wlen = (size_t)(hi - off);
+        char tail[64];
+        if (wlen >= 64) {
+            wlen = 64;
+        } else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, w, wlen);
+            w = tail;
+        }
+        uint64_t bits = structural_bits(w);
+        if (wlen < 64)
+            bits &= (1ULL << wlen) - 1;
+
+        while (bits) {
+            size_t i = (size_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+            char c = w[i];
+            long long pos = off + (long long)i;
+            for (int s = 0; s < 3; s++) {
+                if (in_string[s] && pos == esc_pos[s])
+                    continue;
+                if (c == '\\') {
+                    if (in_string[s]) esc_pos[s] = pos + 1;
+                } else if (c == '"') {
+                    in_string[s] = !in_string[s];
+                } else if (!in_string[s]) {
+                    delta[s] += (c == '{') ? 1 : -1;
+                }
+            }
+        }
+        off += (long long)wlen;
+    }
+
+    RangeTransfer t;
+    for (int s = 0; s < 3; s++) {
+        t.end_state[s] = !in_string[s] ? ST_OUT
+                       : (esc_pos[s] == hi ? ST_IN_ESC : ST_IN);
+        t.depth_delta[s] = delta[s];
+    }
+    return t;
+}
+
+// Pass 2: with the true starting state known, collect the byte position of
+// every '}' that closes a top-level entry (depth back to 1), plus the first
+// '{' that opens the file when this range contains it.
+static void range_boundaries(const char* base, long long lo, long long hi,
+                             int start_state, long long start_depth,
+                             structural_fn structural_bits,
+                             std::vector<long long>& out_bounds,
+                             long long* first_open) {
+    bool in_string = (start_state != ST_OUT);
+    long long esc_pos = (start_state == ST_IN_ESC) ? lo : -1;
+    long long depth = start_depth;
+
+    long long off = lo;
+    while (off < hi) {
+        const char* w = base + off;
+        size_t wlen = (size_t)(hi - off);
+        char tail[64];
+        if (wlen >= 64) {
+            wlen = 64;
+        } else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, w, wlen);
+            w = tail;
+        }
+        uint64_t bits = structural_bits(w);
+        if (wlen < 64)
+            bits &= (1ULL << wlen) - 1;
+
+        while (bits) {
+            size_t i = (size_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+            char c = w[i];
+            long long pos = off + (long long)i;
+
+            if (in_string && pos == esc_pos)
+                continue;
+            if (c == '\\') {
+                if (in_string) esc_pos = pos + 1;
+            } else if (c == '"') {
+                in_string = !in_string;
+            } else if (!in_string) {
+                if (c == '{') {
+                    if (depth == 0)
+                        *first_open = pos;
+                    depth++;
+                } else {
+                    depth--;
+                    if (depth == 1)
+                        out_bounds.push_back(pos);
+                    else if (depth == 0)
+                        return;      // closing brace of the whole file
+                }
+            }
+        }
+        off += (long long)wlen;
+    }
+}
+
+// The two speculative passes plus reconciliation, shared by --parallel and
+// --plan: fills entry_end with the absolute offset of each entry's closing
+// brace and *first_open with the file's opening brace.
+static void parallel_boundaries(const char* base, long long size, int nthreads,
+                                std::vector<long long>& entry_end,
+                                long long* first_open) {
+    const char* scanner_name;
+    structural_fn structural_bits = select_structural_fn(&scanner_name);
+
+    if (nthreads < 1) nthreads = 1;
+    std::vector<long long> cut(nthreads + 1);
+    for (int r = 0; r <= nthreads; r++)
+        cut[r] = size * r / nthreads;
+
+    // Pass 1: per-range transfer functions, in parallel.
+    std::vector<RangeTransfer> transfer(nthreads);
+    {
+        std::vector<std::thread> workers;
+        for (int r = 0; r < nthreads; r++)
+            workers.emplace_back([&, r]() {
+                transfer[r] = range_transfer(base, cut[r], cut[r + 1], structural_bits);
+            });
+        for (auto& w : workers) w.join();
+    }
+
+    // Reconcile: true state and depth at each range start.
+    std::vector<int> start_state(nthreads);
+    std::vector<long long> start_depth(nthreads);
+    int state = ST_OUT;
+    long long depth = 0;
+    for (int r = 0; r < nthreads; r++) {
+        start_state[r] = state;
+        start_depth[r] = depth;
+        depth += transfer[r].depth_delta[state];
+        state = transfer[r].end_state[state];
+    }
+
+    // Pass 2: exact entry boundaries per range, in parallel.
+    std::vector<std::vector<long long>> bounds(nthreads);
+    *first_open = -1;
+    {
+        std::vector<std::thread> workers;
+        for (int r = 0; r < nthreads; r++)
+            workers.emplace_back([&, r]() {
+                range_boundaries(base, cut[r], cut[r + 1], start_state[r],
+                                 start_depth[r], structural_bits,
+                                 bounds[r], first_open);
+            });
+        for (auto& w : workers) w.join();
+    }
+
+    for (int r = 0; r < nthreads; r++)
+        entry_end.insert(entry_end.end(), bounds[r].begin(), bounds[r].end());
+
+    if (!g_quiet)
+        std::cout << "Boundary scan: " << entry_end.size() << " entries" << std::endl;
+}
+
+// First entry index of each batch. With --target-batch-bytes the cuts come
+// from a prefix-sum walk over the span sizes (mirroring the sequential
+// writer's byte accounting; NDJSON re-minifies on write, so there raw span
+// size stands in for the record size); otherwise they are the historical
+// fixed entry-count strides. A rotation landing exactly on the last entry
+// leaves a trailing empty batch -- reported through *stub.
+static std::vector<long long> batch_cuts(const std::vector<long long>& entry_end,
+                                         long long first_open, bool* stub) {
+    long long total = (long long)entry_end.size();
+    std::vector<long long> batch_first{0};
+    if (g_target_bytes > 0) {
+        long long acc = (g_format == FMT_WRAPPED) ? 2 : 0;
+        long long cnt = 0;
+        for (long long k = 0; k < total; k++) {
+            long long lo = (k == 0) ? first_open + 1 : entry_end[k - 1] + 1;
+            if (g_format == FMT_WRAPPED && cnt > 0)
+                acc += 2;
+            acc += entry_end[k] + 1 - lo;
+            if (++cnt >= g_chunk_size || acc >= g_target_bytes) {
+                batch_first.push_back(k + 1);
+                acc = (g_format == FMT_WRAPPED) ? 2 : 0;
+                cnt = 0;
+            }
+        }
+    } else {
+        for (long long f = g_chunk_size; f <= total; f += g_chunk_size)
+            batch_first.push_back(f);
+    }
+    *stub = total == 0 || batch_first.back() == total;
+    if (*stub)
+        batch_first.pop_back();
+    return batch_first;
+}
+
+
+// --- Split plan -------------------------------------------------------------
+// --plan runs only the boundary scanner -- the same two speculative passes as
+// --parallel, with nothing written per entry -- and emits a manifest of the
+// batches a real split would produce: entry counts plus absolute input byte
+// ranges. Distributed jobs can assign batch ranges to machines and extract
+// them with plain offset/length reads instead of re-scanning the dump.
+static int plan_split(InputSource& in, const std::string& input_file,
+                      const std::string& output_dir, int nthreads, int workers) {
+    std::vector<long long> entry_end;
+    long long first_open = -1;
+    parallel_boundaries(in.map, in.map_size, nthreads, entry_end, &first_open);
+    long long total = (long long)entry_end.size();
+
+    bool stub = false;
+    std::vector<long long> batch_first = batch_cuts(entry_end, first_open, &stub);
+    int nbatches = (int)batch_first.size();
+
+    std::string path = output_dir + "/split_plan.json";
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return 1;
+    }
+    fprintf(f, "{\n");
+    fprintf(f, "  \"input\": \"%s\",\n", input_file.c_str());
+    fprintf(f, "  \"input_bytes\": %lld,\n", in.map_size);
+    fprintf(f, "  \"entries\": %lld,\n", total);
+    fprintf(f, "  \"chunk_size\": %lld,\n", g_chunk_size);
+    fprintf(f, "  \"target_batch_bytes\": %lld,\n", g_target_bytes);
+    fprintf(f, "  \"format\": \"%s\",\n",
+            g_format == FMT_NDJSON ? "ndjson" : "wrapped");
+    fprintf(f, "  \"nbatches\": %d,\n", nbatches);
+    fprintf(f, "  \"stub\": %s,\n", stub ? "true" : "false");
+    fprintf(f, "  \"batches\": [");
+    for (int b = 0; b < nbatches; b++) {
+        long long first = batch_first[b];
+        long long last = (b + 1 < nbatches) ? batch_first[b + 1] : total;
+        long long lo = (first == 0) ? first_open + 1 : entry_end[first - 1] + 1;
+        long long hi = entry_end[last - 1] + 1;
+        fprintf(f, "%s\n    {\"batch\": %d, \"file\": \"%s\", "
+                   "\"first_entry\": %lld, \"entries\": %lld, "
+                   "\"input_start\": %lld, \"input_end\": %lld}",
+                b ? "," : "", b + 1,
+                batch_filename(output_dir, b + 1).c_str(),
+                first, last - first, lo, hi);
+    }
+    fprintf(f, "\n  ],\n");
+
+    // --workers: carve the batch list into contiguous runs balanced by input
+    // bytes; each run is one worker invocation (split_json --worker I) that
+    // reads only its byte range from shared storage.
+    if (workers > nbatches) workers = nbatches > 0 ? nbatches : 1;
+    fprintf(f, "  \"workers_total\": %d,\n", workers);
+    fprintf(f, "  \"workers\": [");
+    long long range_lo0 = first_open + 1;
+    long long range_total = (total > 0) ? entry_end[total - 1] + 1 - range_lo0 : 0;
+    int b0 = 0;
+    for (int w = 0; w < workers; w++) {
+        // Advance until this worker's share of the bytes is covered.
+        int b1 = b0;
+        while (b1 < nbatches) {
+            long long hi = (b1 + 1 < nbatches) ? entry_end[batch_first[b1 + 1] - 1] + 1
+                                               : entry_end[total - 1] + 1;
+            b1++;
+            if ((hi - range_lo0) * workers >= range_total * (w + 1))
+                break;
+        }
+        if (w == workers - 1)
+            b1 = nbatches;
+        long long first = batch_first[b0];
+        long long last = (b1 < nbatches) ? batch_first[b1] : total;
+        long long lo = (first == 0) ? first_open + 1 : entry_end[first - 1] + 1;
+        long long hi = (last > 0) ? entry_end[last - 1] + 1 : lo;
+        fprintf(f, "%s\n    {\"worker\": %d, \"first_batch\": %d, "
+                   "\"batches\": %d, \"first_entry\": %lld, "
+                   "\"entries\": %lld, \"input_start\": %lld, "
+                   "\"input_end\": %lld}",
+                w ? "," : "", w, b0 + 1, b1 - b0, first, last - first, lo, hi);
+        b0 = b1;
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+
+    if (!g_quiet)
+        std::cout << "Plan: " << total << " entries in " << nbatches
+                  << " batches, " << workers << " workers -> " << path << std::endl;
+    return 0;
+}
+
+
+// --- Multi-node orchestration -----------------------------------------------
+// A ~200 GB dump doesn't split in acceptable time on one machine even with
+// --parallel. The plan manifest already carries everything a cluster needs:
+// the coordinator runs --plan --workers N once, then each node runs
+// --worker I against the same input and output directory on shared storage.
+// A worker re-derives exact entry boundaries only inside its assigned byte
+// range (the range starts at an entry boundary, so the scan state there is
+// known: depth 1, outside any string), writes the plan's batch files with the
+// plan's numbering, and records what it produced in worker_manifest_NN.json.
+// --merge-workers folds those into one split_manifest.json and verifies the
+// cluster produced every batch the plan called for.
+
+// Field extraction for the machine-written plan/manifest JSON; searches
+// forward from `from`, so locating an object's first key scopes the rest.
+static long long plan_ll(const std::string& s, size_t from, const char* key) {
+    std::string needle = std::string("\"") + key + "\": ";
+    size_t p = s.find(needle, from);
+    if (p == std::string::npos) return -1;
+    return atoll(s.c_str() + p + needle.size());
+}
+
+static std::string plan_str(const std::string& s, size_t from, const char* key) {
+    std::string needle = std::string("\"") + key + "\": \"";
+    size_t p = s.find(needle, from);
+    if (p == std::string::npos) return "";
+    p += needle.size();
+    size_t e = s.find('"', p);
+    return e == std::string::npos ? "" : s.substr(p, e - p);
+}
+
+static bool read_whole_file(const std::string& path, std::string& out) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        out.append(buf, n);
+    fclose(f);
+    return true;
+}
+
+static int worker_split(InputSource& in, const std::string& output_dir,
+                        int worker_id) {
+    std::string plan;
+    std::string plan_path = output_dir + "/split_plan.json";
+    if (!read_whole_file(plan_path, plan)) {
+        std::cerr << "No plan at " << plan_path
+                  << " (coordinator runs --plan --workers N first)" << std::endl;
+        return 1;
+    }
+    if (plan_ll(plan, 0, "input_bytes") != in.map_size) {
+        std::cerr << "Input size does not match the plan" << std::endl;
+        return 1;
+    }
+    int workers_total = (int)plan_ll(plan, 0, "workers_total");
+    if (workers_total < 1 || worker_id >= workers_total) {
+        std::cerr << "Plan has " << workers_total << " workers; bad --worker "
+                  << worker_id << std::endl;
+        return 1;
+    }
+    // The coordinator's splitting parameters override whatever this
+    // invocation defaulted to; mixed parameters would renumber batches.
+    g_chunk_size = plan_ll(plan, 0, "chunk_size");
+    g_target_bytes = plan_ll(plan, 0, "target_batch_bytes");
+    g_format = plan_str(plan, 0, "format") == "ndjson" ? FMT_NDJSON : FMT_WRAPPED;
+    int nbatches = (int)plan_ll(plan, 0, "nbatches");
+    bool stub = plan.find("\"stub\": true") != std::string::npos;
+
+    char wkey[32];
+    snprintf(wkey, sizeof(wkey), "{\"worker\": %d,", worker_id);
+    size_t wpos = plan.find(wkey);
+    if (wpos == std::string::npos) {
+        std::cerr << "Worker " << worker_id << " not in plan" << std::endl;
+        return 1;
+    }
+    int first_batch = (int)plan_ll(plan, wpos, "first_batch");
+    int my_batches = (int)plan_ll(plan, wpos, "batches");
+    long long my_entries = plan_ll(plan, wpos, "entries");
+    long long range_lo = plan_ll(plan, wpos, "input_start");
+    long long range_hi = plan_ll(plan, wpos, "input_end");
+
+    // Exact entry boundaries inside the assigned range only; the range was
+    // cut at an entry boundary, so the scan starts in a known state.
+    const char* scanner_name;
+    structural_fn structural_bits = select_structural_fn(&scanner_name);
+    std::vector<long long> entry_end;
+    long long dummy_open = -1;
+    range_boundaries(in.map, range_lo, range_hi, ST_OUT, 1, structural_bits,
+                     entry_end, &dummy_open);
+    if ((long long)entry_end.size() != my_entries) {
+        std::cerr << "Boundary scan found " << entry_end.size()
+                  << " entries in range, plan says " << my_entries
+                  << "; stale plan?" << std::endl;
+        return 1;
+    }
+
+    std::string manifest_path;
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "/worker_manifest_%02d.json", worker_id);
+        manifest_path = output_dir + name;
+    }
+    FILE* mf = fopen(manifest_path.c_str(), "w");
+    if (!mf) {
+        std::cerr << "Cannot write " << manifest_path << std::endl;
+        return 1;
+    }
+    fprintf(mf, "{\n  \"worker\": %d,\n  \"batches\": [", worker_id);
+
+    // Write this worker's batches exactly as --parallel's write_batch does,
+    // using the plan's file names so the cluster-wide numbering holds.
+    long long cursor = 0;          // next unconsumed entry in entry_end
+    long long written_entries = 0;
+    const char* base = in.map;
+    for (int b = first_batch; b < first_batch + my_batches; b++) {
+        char bkey[32];
+        snprintf(bkey, sizeof(bkey), "{\"batch\": %d,", b);
+        size_t bpos = plan.find(bkey);
+        std::string name = plan_str(plan, bpos, "file");
+        long long n = plan_ll(plan, bpos, "entries");
+        if (bpos == std::string::npos || name.empty() || n < 0) {
+            std::cerr << "Batch " << b << " missing from plan" << std::endl;
+            fclose(mf);
+            return 1;
+        }
+        std::ofstream out(name);
+        if (!out) {
+            std::cerr << "Cannot write " << name << std::endl;
+            fclose(mf);
+            return 1;
+        }
+        long long out_off = 0;
+        if (g_format == FMT_WRAPPED) {
+            out << "{\n";
+            out_off = 2;
+        }
+        std::vector<IdxRecord> idx;
+        bool first_in_file = true;
+        for (long long k = cursor; k < cursor + n; k++) {
+            long long lo = (k == 0) ? range_lo : entry_end[k - 1] + 1;
+            long long hi = entry_end[k] + 1;
+            long long emitted;
+            if (g_format == FMT_NDJSON) {
+                std::string line = ndjson_record(base + lo, (size_t)(hi - lo));
+                out.write(line.data(), (long long)line.size());
+                emitted = (long long)line.size();
+            } else {
+                if (!first_in_file) {
+                    out << ",\n";
+                    out_off += 2;
+                }
+                first_in_file = false;
+                out.write(base + lo, hi - lo);
+                emitted = hi - lo;
+            }
+            if (g_index) {
+                const char* kp;
+                size_t kn;
+                if (span_key(base + lo, (size_t)(hi - lo), &kp, &kn))
+                    idx.push_back(IdxRecord{key_hash64(kp, kn),
+                                            (uint64_t)out_off, (uint64_t)emitted,
+                                            key_hash64(kp - 1,
+                                                       (size_t)(base + hi - (kp - 1)))});
+            }
+            out_off += emitted;
+        }
+        if (g_format == FMT_WRAPPED) {
+            out << "\n}";
+            out_off += 2;
+        }
+        out.close();
+        if (g_index)
+            write_index(name, idx);
+        cursor += n;
+        written_entries += n;
+        fprintf(mf, "%s\n    {\"batch\": %d, \"file\": \"%s\", "
+                    "\"entries\": %lld, \"bytes\": %lld}",
+                b == first_batch ? "" : ",", b, name.c_str(), n, out_off);
+        if (!g_quiet)
+            std::cout << "Wrote " << name << " (" << n << " entries)" << std::endl;
+    }
+
+    // The stub batch the sequential splitter leaves when the last entry
+    // triggers rotation belongs to whoever owns the last real batch.
+    if (stub && first_batch + my_batches - 1 == nbatches) {
+        std::ofstream sf(batch_filename(output_dir, nbatches + 1));
+        if (g_format == FMT_WRAPPED)
+            sf << "{\n";
+    }
+
+    fprintf(mf, "\n  ],\n  \"entries\": %lld\n}\n", written_entries);
+    fclose(mf);
+    std::cout << "Worker " << worker_id << ": " << written_entries
+              << " entries in " << my_batches << " batches -> "
+              << manifest_path << std::endl;
+    return 0;
+}
+
+// Coordinator's final step: checks every worker reported, and folds the
+// per-worker manifests into one split_manifest.json in batch order.
+static int merge_worker_manifests(const std::string& output_dir) {
+    std::string plan;
+    if (!read_whole_file(output_dir + "/split_plan.json", plan)) {
+        std::cerr << "No plan in " << output_dir << std::endl;
+        return 1;
+    }
+    int workers_total = (int)plan_ll(plan, 0, "workers_total");
+    int nbatches = (int)plan_ll(plan, 0, "nbatches");
+    if (workers_total < 1) {
+        std::cerr << "Plan has no worker assignments" << std::endl;
+        return 1;
+    }
+
+    std::string merged = output_dir + "/split_manifest.json";
+    FILE* f = fopen(merged.c_str(), "w");
+    if (!f) {
+        std::cerr << "Cannot write " << merged << std::endl;
+        return 1;
+    }
+    fprintf(f, "{\n  \"input\": \"%s\",\n", plan_str(plan, 0, "input").c_str());
+    fprintf(f, "  \"batches\": [");
+
+    long long total_entries = 0;
+    int batches_seen = 0;
+    bool first = true;
+    for (int w = 0; w < workers_total; w++) {
+        char name[64];
+        snprintf(name, sizeof(name), "/worker_manifest_%02d.json", w);
+        std::string wm;
+        if (!read_whole_file(output_dir + name, wm)) {
+            std::cerr << "Worker " << w << " has not reported ("
+                      << output_dir << name << " missing)" << std::endl;
+            fclose(f);
+            unlink(merged.c_str());
+            return 1;
+        }
+        // Walk the worker's batch objects in order.
+        for (size_t p = wm.find("{\"batch\": "); p != std::string::npos;
+             p = wm.find("{\"batch\": ", p + 1)) {
+            std::string file = plan_str(wm, p, "file");
+            long long n = plan_ll(wm, p, "entries");
+            long long bytes = plan_ll(wm, p, "bytes");
+            struct stat st;
+            if (stat(file.c_str(), &st) != 0 || st.st_size != bytes) {
+                std::cerr << "Batch file " << file
+                          << " missing or truncated" << std::endl;
+                fclose(f);
+                unlink(merged.c_str());
+                return 1;
+            }
+            fprintf(f, "%s\n    {\"batch\": %lld, \"file\": \"%s\", "
+                       "\"entries\": %lld, \"bytes\": %lld, \"worker\": %d}",
+                    first ? "" : ",", plan_ll(wm, p, "batch"), file.c_str(),
+                    n, bytes, w);
+            first = false;
+            total_entries += n;
+            batches_seen++;
+        }
+    }
+    fprintf(f, "\n  ],\n  \"entries\": %lld\n}\n", total_entries);
+    fclose(f);
+
+    if (batches_seen != nbatches) {
+        std::cerr << "Plan calls for " << nbatches << " batches, workers "
+                  "produced " << batches_seen << std::endl;
+        return 1;
+    }
+    std::cout << "Merged " << workers_total << " workers: " << total_entries
+              << " entries in " << batches_seen << " batches -> " << merged
+              << std::endl;
+    return 0;
+}
+
+static SplitResult parallel_split(InputSource& in, const std::string& output_dir, int nthreads) {
+    const char* base = in.map;
+    long long size = in.map_size;
+
+    std::vector<long long> entry_end;
+    long long first_open = -1;
+    parallel_boundaries(base, size, nthreads, entry_end, &first_open);
+    long long total = (long long)entry_end.size();
+
+    SplitResult res;
+    res.total_entries = total;
+
+    bool stub = false;
+    std::vector<long long> batch_first = batch_cuts(entry_end, first_open, &stub);
+    int nbatches = (int)batch_first.size();
+    res.file_num = nbatches + (stub ? 1 : 0);
+
+    // Entry k spans (end[k-1], end[k]]; the first entry starts just past the
+    // file's opening brace. This matches what the sequential entry buffer
+    // accumulates, separators included.
+    auto write_batch = [&](int b) {
+        long long first = batch_first[b];
+        long long last = (b + 1 < nbatches) ? batch_first[b + 1] : total;
+
+        std::string name = batch_filename(output_dir, b + 1);
+        std::ofstream out(name);
+        long long out_off = 0;
+        if (g_format == FMT_WRAPPED) {
+            out << "{\n";
+            out_off = 2;
+        }
+        std::vector<IdxRecord> idx;
+        bool first_in_file = true;
+        for (long long k = first; k < last; k++) {
+            long long lo = (k == 0) ? first_open + 1 : entry_end[k - 1] + 1;
+            long long hi = entry_end[k] + 1;
+            long long emitted;
+            if (g_format == FMT_NDJSON) {
+                std::string line = ndjson_record(base + lo, (size_t)(hi - lo));
+                out.write(line.data(), (long long)line.size());
+                emitted = (long long)line.size();
+            } else {
+                if (!first_in_file) {
+                    out << ",\n";
+                    out_off += 2;
+                }
+                first_in_file = false;
+                out.write(base + lo, hi - lo);
+                emitted = hi - lo;
+            }
+            if (g_index) {
+                const char* kp;
+                size_t kn;
+                if (span_key(base + lo, (size_t)(hi - lo), &kp, &kn))
+                    idx.push_back(IdxRecord{key_hash64(kp, kn),
+                                            (uint64_t)out_off, (uint64_t)emitted,
+                                            key_hash64(kp - 1,
+                                                       (size_t)(base + hi - (kp - 1)))});
+            }
+            out_off += emitted;
+        }
+        if (g_format == FMT_WRAPPED)
+            out << "\n}";
+        out.close();
+        if (g_index)
+            write_index(name, idx);
+        if (!g_quiet)
+            std::cout << "Wrote " << name << " (" << (last - first) << " entries)" << std::endl;
+    };
+
+    {
+        std::vector<std::thread> workers;
+        std::atomic<int> next_batch{0};
+        int nw = nthreads < nbatches ? nthreads : nbatches;
+        for (int t = 0; t < nw; t++)
+            workers.emplace_back([&]() {
+                for (;;) {
+                    int b = next_batch.fetch_add(1);
+                    if (b >= nbatches) break;
+                    write_batch(b);
+                }
+            });
+        for (auto& w : workers) w.join();
+    }
+
+    // The sequential splitter eagerly opens the next batch file on rotation;
+    // when the last entry itself triggers a rotation that leaves a stub
+    // holding only the header. Reproduce it.
+    if (stub) {
+        std::ofstream stub(batch_filename(output_dir, res.file_num));
+        if (g_format == FMT_WRAPPED)
+            stub << "{\n";
+    }
+
+    return res;
+}
+
+
+// --- Benchmark harness ------------------------------------------------------
+// `--bench` compares the input/scan engines this directory exists to test
+// (scalar ifstream, buffered fread, mmap scalar, mmap+SIMD) over the first
+// --bench-bytes of the input, with warmup and repetitions, and reports MB/s,
+// entries/s, cycles/byte and peak RSS. --bench-csv appends machine-readable
+// rows so regressions can be tracked across compiler and hardware changes.
+
+#include <sys/resource.h>
+
+static inline uint64_t bench_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static double bench_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Scalar boundary machine over one buffer; returns entries seen.
+static long long bench_scan_scalar(const char* p, size_t n, int& depth,
+                                   bool& in_string, bool& escape, bool& found) {
+    long long entries = 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = p[i];
+        if (!found) {
+            if (c == '{') { found = true; depth = 1; }
+            continue;
+        }
+        if (escape) { escape = false; continue; }
+        if (c == '\\' && in_string) { escape = true; continue; }
+        if (c == '"') { in_string = !in_string; continue; }
+        if (in_string) continue;
+        if (c == '{') depth++;
+        else if (c == '}') { depth--; if (depth == 1) entries++; else if (depth == 0) break; }
+    }
+    return entries;
+}
+
+struct BenchResult {
+    double seconds = 0;
+    long long bytes = 0;
+    long long entries = 0;
+    uint64_t ticks = 0;
+};
+
+static BenchResult bench_variant(const std::string& which, const std::string& path,
+                                 long long limit) {
+    BenchResult r;
+    int depth = 0;
+    bool in_string = false, escape = false, found = false;
+    double t0 = bench_seconds();
+    uint64_t c0 = bench_ticks();
+
+    if (which == "ifstream") {
+        std::ifstream in(path, std::ios::binary);
+        char c;
+        int d = 0; bool st = false, es = false, fo = false;
+        while (r.bytes < limit && in.get(c)) {
+            r.bytes++;
+            r.entries += bench_scan_scalar(&c, 1, d, st, es, fo);
+        }
+    } else if (which == "fread") {
+        FILE* f = fopen(path.c_str(), "rb");
+        char* buf = (char*)malloc(g_block_size);
+        size_t n;
+        while (r.bytes < limit &&
+               (n = fread(buf, 1, g_block_size, f)) > 0) {
+            if ((long long)n > limit - r.bytes) n = (size_t)(limit - r.bytes);
+            r.entries += bench_scan_scalar(buf, n, depth, in_string, escape, found);
+            r.bytes += (long long)n;
+        }
+        free(buf);
+        fclose(f);
+    } else if (which == "mmap" || which == "simd") {
+        InputSource in;
+        if (!input_open(in, path) || !in.mapped) {
+            std::cerr << "bench: cannot mmap " << path << std::endl;
+            return r;
+        }
+        long long n = in.map_size < limit ? in.map_size : limit;
+        if (which == "mmap") {
+            r.entries = bench_scan_scalar(in.map, (size_t)n, depth, in_string, escape, found);
+        } else {
+            const char* name;
+            structural_fn fn = select_structural_fn(&name);
+            long long esc_pos = -1;
+            long long off = 0;
+            bool done = false;
+            while (off < n && !done) {
+                const char* w = in.map + off;
+                size_t wlen = (size_t)(n - off);
+                char tailbuf[64];
+                if (wlen >= 64) wlen = 64;
+                else { memset(tailbuf, 0, 64); memcpy(tailbuf, w, wlen); w = tailbuf; }
+                uint64_t bits = fn(w);
+                if (wlen < 64) bits &= (1ULL << wlen) - 1;
+                while (bits) {
+                    size_t i = (size_t)__builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    char c = w[i];
+                    long long pos = off + (long long)i;
+                    if (!found) { if (c == '{') { found = true; depth = 1; } continue; }
+                    if (in_string && pos == esc_pos) continue;
+                    if (c == '\\') { if (in_string) esc_pos = pos + 1; continue; }
+                    if (c == '"') { in_string = !in_string; continue; }
+                    if (in_string) continue;
+                    if (c == '{') depth++;
+                    else if (c == '}') {
+                        depth--;
+                        if (depth == 1) r.entries++;
+                        else if (depth == 0) { done = true; break; }
+                    }
+                }
+                off += (long long)wlen;
+            }
+        }
+        r.bytes = n;
+        input_close(in);
+    }
+
+    r.ticks = bench_ticks() - c0;
+    r.seconds = bench_seconds() - t0;
+    return r;
+}
+
+static int run_bench(const std::string& input_file, long long bench_bytes,
+                     int reps, int warmup, const std::string& csv_path) {
+    struct stat st;
+    if (stat(input_file.c_str(), &st) != 0) {
+        std::cerr << "Cannot open " << input_file << std::endl;
+        return 1;
+    }
+    long long limit = bench_bytes > 0 && bench_bytes < (long long)st.st_size
+                    ? bench_bytes : (long long)st.st_size;
+
+    FILE* csv = nullptr;
+    if (!csv_path.empty()) {
+        bool fresh = stat(csv_path.c_str(), &st) != 0;
+        csv = fopen(csv_path.c_str(), "a");
+        if (csv && fresh)
+            fprintf(csv, "variant,rep,bytes,seconds,mb_per_s,entries,entries_per_s,"
+                         "cycles_per_byte,peak_rss_kb\n");
+    }
+
+    const char* variants[] = {"ifstream", "fread", "mmap", "simd"};
+    printf("%-10s %4s %12s %10s %12s %14s %8s\n",
+           "variant", "rep", "MB/s", "sec", "entries", "cycles/byte", "RSS(MB)");
+    for (const char* v : variants) {
+        for (int rep = -warmup; rep < reps; rep++) {
+            BenchResult r = bench_variant(v, input_file, limit);
+            if (rep < 0) continue;              // warmup runs are not reported
+            struct rusage ru;
+            getrusage(RUSAGE_SELF, &ru);
+            double mbs = r.seconds > 0 ? r.bytes / r.seconds / (1024 * 1024) : 0;
+            double eps = r.seconds > 0 ? r.entries / r.seconds : 0;
+            double cpb = r.bytes > 0 ? (double)r.ticks / (double)r.bytes : 0;
+            printf("%-10s %4d %12.1f %10.3f %12lld %14.2f %8ld\n",
+                   v, rep, mbs, r.seconds, r.entries, cpb, ru.ru_maxrss / 1024);
+            if (csv)
+                fprintf(csv, "%s,%d,%lld,%.6f,%.1f,%lld,%.0f,%.3f,%ld\n",
+                        v, rep, r.bytes, r.seconds, mbs, r.entries, eps, cpb,
+                        ru.ru_maxrss);
+        }
+    }
+    if (csv) fclose(csv);
+    return 0;
+}
+
+static void print_usage() {
+    std::cout <<
+        "Usage: split_json [options] [input.json] [output_dir]\n"
+        "Split a wrapped Wikidata JSON dump into numbered batch files.\n"
+        "  input.json            input dump (default extracted_data.json)\n"
+        "  output_dir            batch directory (default extracted_batches)\n"
+        "  --chunk-size N        entries per batch (default 500000)\n"
+        "  --target-batch-bytes SIZE  rotate batches by output bytes instead,\n"
+        "                        K/M/G suffixes ok; entry count stays as a cap\n"
+        "  --pattern FMT         batch name stem with one %d directive\n"
+        "                        (default extracted_data_%03d)\n"
+        "  --shards N            spread batches over N shard_NN subdirectories\n"
+        "                        and write a shard manifest\n"
+        "  --block-size BYTES    read block size, K/M/G suffixes ok (default 8M)\n"
+        "  --pipeline            overlap reading and scanning on two threads\n"
+        "  --async-out           overlap batch writes with scanning\n"
+        "  --parallel [N]        split with N scanner threads (default: all cores)\n"
+        "  --plan                boundary scan only: write a byte-range manifest\n"
+        "                        of the would-be batches, no batch output\n"
+        "  --checkpoint          write a resumable checkpoint while splitting\n"
+        "  --checkpoint-interval N   seconds between checkpoints (default 5)\n"
+        "  --resume              continue from an interrupted checkpointed run\n"
+        "  --filter-keys FILE    only emit entries whose top-level key is in\n"
+        "                        FILE (one key per line)\n"
+        "  --ndjson              emit one {\"id\", \"value\"} record per line\n"
+        "  --validate            check UTF-8 and string escapes per entry;\n"
+        "                        offsets go to <output_dir>/validation_report.txt\n"
+        "  --validate-repair     also patch invalid bytes/escapes in the output\n"
+        "  --recover             validate entries and resync on malformed\n"
+        "                        input; rejected spans go to\n"
+        "                        <output_dir>/quarantine.dat with offsets\n"
+        "  --stats               accumulate entry size/depth statistics during\n"
+        "                        the split; writes <output_dir>/split_stats.json\n"
+        "  --project LIST        extract the listed property IDs (comma-\n"
+        "                        separated, e.g. P577,P50) into per-property\n"
+        "                        column_Pnnn.tsv files while splitting\n"
+        "  --diff PREV_DIR       emit only entries added or changed since the\n"
+        "                        indexed run in PREV_DIR; removed keys go to\n"
+        "                        <output_dir>/removed_keys.txt\n"
+        "  --sqlite DB           insert (instance_id, entry_json) rows into DB\n"
+        "                        instead of writing batch files\n"
+        "  --index               write binary .idx sidecars for lookup_entry\n"
+        "  --compress zstd[:N]   compress batches to .zst at level N (default 3)\n"
+        "  --workers N           with --plan: assign contiguous byte ranges\n"
+        "                        to N worker invocations in the manifest\n"
+        "  --worker I            run worker I's share of an existing plan\n"
+        "                        (same input and output_dir on shared storage)\n"
+        "  --merge-workers       verify worker manifests and fold them into\n"
+        "                        <output_dir>/split_manifest.json\n"
+        "  --max-entry-bytes SZ  cap on in-memory entry size; larger entries\n"
+        "                        spill to <output_dir>/large_entries.json in\n"
+        "                        chunks (or are dropped with\n"
+        "                        --oversize-policy skip), offsets logged\n"
+        "  --oversize-policy P   spill (default) or skip\n"
+        "  --profile             per-stage cycle counters, byte-class ratios\n"
+        "                        and branch statistics for the scan; writes\n"
+        "                        <output_dir>/split_profile.json\n"
+        "  --follow              tail a still-growing input file; finishes\n"
+        "                        when the closing brace of the dump arrives\n"
+        "  --bench               run the scanner benchmark and exit\n"
+        "  --quiet               no progress or per-batch output\n";
+}
+
+int main(int argc, char** argv) {
+    std::string input_file = "extracted_data.json";
+    std::string output_dir = "extracted_batches";
+    bool pipeline = false;
+    bool async_out = false;
+    int parallel = 0;              // 0 = off, otherwise worker count
+    bool checkpoint = false;
+    int checkpoint_interval = 5;
+    bool resume = false;
+    int zstd_level = 0;            // 0 = no compression
+    std::string sqlite_db;
+    const char* project_list = nullptr;
+    std::string diff_prev;
+    bool plan = false;
+    int plan_workers = 0;          // --plan --workers N
+    int worker_id = -1;            // --worker I
+    bool merge_workers = false;
+    bool bench = false;
+    long long bench_bytes = 0;     // 0 = whole file
+    int bench_reps = 3;
+    int bench_warmup = 1;
+    std::string bench_csv;
+
+    int npos = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage();
+            return 0;
+        } else if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+            g_chunk_size = atoll(argv[++i]);
+            if (g_chunk_size < 1) {
+                std::cerr << "Bad --chunk-size" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+            g_name_pattern = argv[++i];
+            // One integer directive, nothing else printf would expand.
+            size_t pct = g_name_pattern.find('%');
+            if (pct == std::string::npos ||
+                g_name_pattern.find('%', pct + 1) != std::string::npos ||
+                g_name_pattern.find_first_of("diu", pct) == std::string::npos) {
+                std::cerr << "--pattern needs exactly one %d directive" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--target-batch-bytes") == 0 && i + 1 < argc) {
+            g_target_bytes = parse_size(argv[++i]);
+            if (g_target_bytes < 1) {
+                std::cerr << "Bad --target-batch-bytes" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            g_shard_fanout = atoi(argv[++i]);
+            if (g_shard_fanout < 1 || g_shard_fanout > 100) {
+                std::cerr << "Bad --shards (1-100)" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) {
+            long long sz = parse_size(argv[++i]);
+            if (sz < 64 * 1024) {
+                std::cerr << "Bad --block-size (min 64K)" << std::endl;
+                return 1;
+            }
+            g_block_size = (size_t)sz;
+        } else if (strcmp(argv[i], "--max-entry-bytes") == 0 && i + 1 < argc) {
+            static Oversize oversize_store;
+            oversize_store.cap = parse_size(argv[++i]);
+            if (oversize_store.cap < 4096) {
+                std::cerr << "Bad --max-entry-bytes (min 4K)" << std::endl;
+                return 1;
+            }
+            g_oversize = &oversize_store;
+        } else if (strcmp(argv[i], "--oversize-policy") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "skip") != 0 && strcmp(argv[i], "spill") != 0) {
+                std::cerr << "Bad --oversize-policy (spill or skip)" << std::endl;
+                return 1;
+            }
+            if (!g_oversize) {
+                std::cerr << "--oversize-policy needs --max-entry-bytes" << std::endl;
+                return 1;
+            }
+            g_oversize->skip = strcmp(argv[i], "skip") == 0;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            static Profile profile_store;
+            g_profile = &profile_store;
+        } else if (strcmp(argv[i], "--follow") == 0) {
+            g_follow = true;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = true;
+        } else if (strcmp(argv[i], "--async-out") == 0) {
+            async_out = true;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            plan_workers = atoi(argv[++i]);
+            if (plan_workers < 1 || plan_workers > 1000) {
+                std::cerr << "Bad --workers (1-1000)" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc) {
+            worker_id = atoi(argv[++i]);
+            if (worker_id < 0) {
+                std::cerr << "Bad --worker" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--merge-workers") == 0) {
+            merge_workers = true;
+        } else if (strcmp(argv[i], "--plan") == 0) {
+            plan = true;
+        } else if (strcmp(argv[i], "--parallel") == 0) {
+            parallel = (int)std::thread::hardware_concurrency();
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+                parallel = atoi(argv[++i]);
+            if (parallel < 1) parallel = 1;
+        } else if (strcmp(argv[i], "--checkpoint") == 0) {
+            checkpoint = true;
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+            checkpoint = true;
+            checkpoint_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = true;
+            checkpoint = true;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--bench-bytes") == 0 && i + 1 < argc) {
+            bench_bytes = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-reps") == 0 && i + 1 < argc) {
+            bench_reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-warmup") == 0 && i + 1 < argc) {
+            bench_warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-csv") == 0 && i + 1 < argc) {
+            bench_csv = argv[++i];
+        } else if (strcmp(argv[i], "--filter-keys") == 0 && i + 1 < argc) {
+            if (!load_filter_keys(argv[++i])) {
+                std::cerr << "Cannot read any keys from " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ndjson") == 0) {
+            g_format = FMT_NDJSON;
+        } else if (strcmp(argv[i], "--index") == 0) {
+            g_index = true;
+        } else if (strcmp(argv[i], "--project") == 0 && i + 1 < argc) {
+            static Projection projection_store;
+            g_project = &projection_store;
+            project_list = argv[++i];
+        } else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+            static DumpDiff diff_store;
+            g_diff = &diff_store;
+            diff_prev = argv[++i];
+        } else if (strcmp(argv[i], "--sqlite") == 0 && i + 1 < argc) {
+            sqlite_db = argv[++i];
+#ifndef SPLIT_JSON_HAVE_SQLITE
+            std::cerr << "This build has no SQLite support (build with "
+                         "SPLIT_JSON_WITH_SQLITE and sqlite3 headers)" << std::endl;
+            return 1;
+#endif
+        } else if (strcmp(argv[i], "--validate") == 0 ||
+                   strcmp(argv[i], "--validate-repair") == 0) {
+            static Validator validator_store;
+            g_validate = &validator_store;
+            if (strcmp(argv[i], "--validate-repair") == 0)
+                g_validate->repair = true;
+        } else if (strcmp(argv[i], "--recover") == 0) {
+            static Quarantine quar_store;
+            g_quarantine = &quar_store;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            static SplitStats stats_store;
+            g_stats = &stats_store;
+        } else if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
+            const char* spec = argv[++i];
+            if (strncmp(spec, "zstd", 4) != 0) {
+                std::cerr << "Unknown compression: " << spec << std::endl;
+                return 1;
+            }
+            zstd_level = spec[4] == ':' ? atoi(spec + 5) : 3;
+#ifndef SPLIT_JSON_HAVE_ZSTD
+            std::cerr << "This build has no zstd support (libzstd headers were "
+                         "not found at compile time)" << std::endl;
+            return 1;
+#endif
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            g_quiet = true;
+        } else if ((argv[i][0] != '-' || strcmp(argv[i], "-") == 0) && npos < 2) {
+            (npos++ == 0 ? input_file : output_dir) = argv[i];
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (bench)
+        return run_bench(input_file, bench_bytes, bench_reps, bench_warmup, bench_csv);
+
+    if (plan && (checkpoint || resume || g_index || zstd_level > 0 ||
+                 !sqlite_db.empty() || !g_filter_keys.empty() || g_stats ||
+                 g_quarantine || g_validate || g_project || g_diff)) {
+        std::cerr << "--plan only scans boundaries; output options do not apply" << std::endl;
+        return 1;
+    }
+    if (plan_workers > 0 && !plan && worker_id < 0) {
+        std::cerr << "--workers only applies to --plan" << std::endl;
+        return 1;
+    }
+    if (worker_id >= 0 && (plan || merge_workers || checkpoint || resume ||
+                           parallel > 0 || zstd_level > 0 || !sqlite_db.empty() ||
+                           !g_filter_keys.empty() || g_stats || g_quarantine ||
+                           g_validate || g_project || g_diff || g_oversize)) {
+        std::cerr << "--worker writes exactly the plan's batches; per-entry "
+                     "options belong on the coordinator's plan run" << std::endl;
+        return 1;
+    }
+    if (merge_workers)
+        return merge_worker_manifests(output_dir);
+
+    // Checkpointing needs the synchronous writer's exact batch state.
+    if ((checkpoint || resume) && (pipeline || async_out || parallel > 0)) {
+        std::cerr << "--checkpoint/--resume only work in the default sequential mode" << std::endl;
+        return 1;
+    }
+    if (zstd_level > 0 && (parallel > 0 || checkpoint || resume || g_index)) {
+        std::cerr << "--compress works in sequential/pipelined runs without "
+                     "--index or checkpointing" << std::endl;
+        return 1;
+    }
+    if (!g_filter_keys.empty() && parallel > 0) {
+        std::cerr << "--filter-keys runs in the sequential/pipelined scan" << std::endl;
+        return 1;
+    }
+    if (g_stats && parallel > 0) {
+        std::cerr << "--stats runs in the sequential/pipelined scan" << std::endl;
+        return 1;
+    }
+    if (!sqlite_db.empty() &&
+        (parallel > 0 || checkpoint || resume || g_index ||
+         zstd_level > 0 || g_format == FMT_NDJSON)) {
+        std::cerr << "--sqlite runs in the sequential/pipelined scan and "
+                     "replaces the file output" << std::endl;
+        return 1;
+    }
+    if (g_oversize && parallel > 0) {
+        std::cerr << "--max-entry-bytes runs in the sequential/pipelined scan; "
+                     "drop --parallel" << std::endl;
+        return 1;
+    }
+    if (g_profile && parallel > 0) {
+        std::cerr << "--profile instruments the sequential/pipelined scan; "
+                     "drop --parallel" << std::endl;
+        return 1;
+    }
+    bool streaming = g_follow || input_file == "-";
+    if (streaming && (resume || plan || parallel > 0)) {
+        std::cerr << "Streaming input (--follow or stdin) is sequential and "
+                     "unseekable; drop --resume/--plan/--parallel" << std::endl;
+        return 1;
+    }
+    if (g_follow && input_file == "-") {
+        std::cerr << "--follow needs a file path to tail, not stdin" << std::endl;
+        return 1;
+    }
+    if (g_diff && (parallel > 0 || checkpoint || resume)) {
+        std::cerr << "--diff runs in the sequential/pipelined scan, without "
+                     "checkpointing" << std::endl;
+        return 1;
+    }
+    if (g_project && parallel > 0) {
+        std::cerr << "--project runs in the sequential/pipelined scan" << std::endl;
+        return 1;
+    }
+    if (g_validate && parallel > 0) {
+        std::cerr << "--validate runs in the sequential/pipelined scan" << std::endl;
+        return 1;
+    }
+    if (g_quarantine && (parallel > 0 || checkpoint || resume)) {
+        std::cerr << "--recover runs in the sequential/pipelined scan, without "
+                     "checkpointing" << std::endl;
+        return 1;
+    }
+    if (resume && g_index) {
+        std::cerr << "--index cannot continue across --resume (indexes of finished batches are kept)" << std::endl;
+        return 1;
+    }
+
+    mkdir(output_dir.c_str(), 0755);
+    for (int sh = 0; sh < g_shard_fanout; sh++) {
+        char dir[384];
+        snprintf(dir, sizeof(dir), "%s/shard_%02d", output_dir.c_str(), sh);
+        mkdir(dir, 0755);
+    }
+
+    if (g_oversize && !g_oversize->open(output_dir)) {
+        std::cerr << "Cannot write oversize files in " << output_dir << std::endl;
+        return 1;
+    }
+
+    if (g_quarantine && !g_quarantine->open(output_dir + "/quarantine.dat")) {
+        std::cerr << "Cannot write " << output_dir << "/quarantine.dat" << std::endl;
+        return 1;
+    }
+
+    if (g_validate && !g_validate->open(output_dir + "/validation_report.txt")) {
+        std::cerr << "Cannot write " << output_dir << "/validation_report.txt" << std::endl;
+        return 1;
+    }
+
+    if (g_project && !g_project->open(output_dir, project_list)) {
+        std::cerr << "Cannot open projection columns for " << project_list << std::endl;
+        return 1;
+    }
+
+    if (g_diff && !g_diff->load(diff_prev)) {
+        std::cerr << "No usable v2 index sidecars under " << diff_prev << std::endl;
+        return 1;
+    }
+
+#ifdef SPLIT_JSON_HAVE_SQLITE
+    SqliteSink sqlite_sink;
+    if (!sqlite_db.empty()) {
+        if (!sqlite_sink.open(sqlite_db)) {
+            std::cerr << "Cannot open database " << sqlite_db << std::endl;
+            return 1;
+        }
+        g_sqlite = &sqlite_sink;
+    }
+#endif
+
+    InputSource in;
+    if (!input_open(in, input_file)) {
+        std::cerr << "Cannot open " << input_file << std::endl;
+        return 1;
+    }
+
+    const char* scanner_name;
+    select_structural_fn(&scanner_name);
+    if (!g_quiet) {
+        if (in.mapped || in.file_size > 0)
+            std::cout << "File size: " << (in.file_size / 1024 / 1024) << " MB";
+        else
+            std::cout << "Streaming input";
+        std::cout << (in.mapped ? " (mmap" : " (buffered") << ", " << scanner_name
+              << " scanner" << (pipeline ? ", pipelined)" : ")") << std::endl;
+    }
+
+    if (plan) {
+        if (!in.mapped) {
+            std::cerr << "--plan needs mmap input" << std::endl;
+            input_close(in);
+            return 1;
+        }
+        int nt = parallel > 0 ? parallel
+                              : (int)std::thread::hardware_concurrency();
+        int rc = plan_split(in, input_file, output_dir, nt, plan_workers);
+        input_close(in);
+        return rc;
+    }
+
+    if (worker_id >= 0) {
+        if (!in.mapped) {
+            std::cerr << "--worker needs mmap input" << std::endl;
+            input_close(in);
+            return 1;
+        }
+        int rc = worker_split(in, output_dir, worker_id);
+        input_close(in);
+        return rc;
+    }
+
+    SplitResult res;
+    if (parallel > 0 && !in.mapped) {
+        std::cerr << "--parallel needs mmap input, falling back to sequential" << std::endl;
+        parallel = 0;
+    }
+
+    Checkpointing ckpt;
+    if (checkpoint) {
+        ckpt.path = output_dir + "/split_checkpoint";
+        ckpt.interval_sec = checkpoint_interval;
+    }
+
+    if (checkpoint || resume) {
+        ScanResume rs;
+        if (resume) {
+            if (!read_checkpoint(ckpt.path, rs)) {
+                std::cerr << "No usable checkpoint at " << ckpt.path << std::endl;
+                return 1;
+            }
+            if (!input_seek(in, rs.pos)) {
+                std::cerr << "Cannot seek input to checkpoint offset" << std::endl;
+                return 1;
+            }
+            if (!g_quiet)
+                std::cout << "Resuming at byte " << rs.pos << " (file " << rs.file_num
+                          << ", " << rs.total_entries << " entries done)" << std::endl;
+        }
+        DirectBlockProvider src(in);
+        DirectBatchWriter sink(output_dir);
+        if (resume && !sink.resume_batch(rs.file_num, rs.out_bytes))
+            return 1;
+        ProgressReporter prog;
+        prog.start(in.file_size);
+        res = scan_split(src, sink, in.file_size, output_dir, ckpt, rs, &prog);
+        prog.finish();
+        unlink(ckpt.path.c_str());     // completed: a stale checkpoint would only confuse
+    } else if (parallel > 0) {
+        res = parallel_split(in, output_dir, parallel);
+    } else {
+        std::unique_ptr<BlockProvider> src;
+        if (pipeline)
+            src.reset(new PipelinedBlockProvider(in));
+        else
+            src.reset(new DirectBlockProvider(in));
+
+        std::unique_ptr<BatchWriter> sink;
+        if (!sqlite_db.empty())
+            sink.reset(new NullBatchWriter());
+        else if (zstd_level > 0) {
+#ifdef SPLIT_JSON_HAVE_ZSTD
+            sink.reset(new ZstdBatchWriter(output_dir, zstd_level));
+#endif
+        } else if (async_out)
+            sink.reset(new AsyncBatchWriter(output_dir));
+        else if (pipeline)
+            sink.reset(new PipelinedBatchWriter(output_dir, in.mapped));
+        else
+            sink.reset(new DirectBatchWriter(output_dir));
+
+        ProgressReporter prog;
+        prog.start(in.file_size);
+        res = scan_split(*src, *sink, in.file_size, output_dir, Checkpointing(), ScanResume(), &prog);
+        prog.finish();
+    }
+
+    input_close(in);
+
+#ifdef SPLIT_JSON_HAVE_SQLITE
+    if (g_sqlite) {
+        sqlite_sink.close();
+        std::cout << (g_quiet ? "" : "\n\n") << "Loaded " << sqlite_sink.rows
+                  << " rows into " << sqlite_db << std::endl;
+    }
+#endif
+
+    if (g_diff) {
+        std::string removed_path = output_dir + "/removed_keys.txt";
+        if (!g_diff->write_removed(removed_path))
+            std::cerr << "Cannot write " << removed_path << std::endl;
+        std::cout << (g_quiet ? "" : "\n\n") << "Diff vs " << diff_prev << ": "
+                  << g_diff->added << " added, " << g_diff->changed
+                  << " changed, " << g_diff->unchanged << " unchanged, "
+                  << g_diff->removed << " removed" << std::endl;
+    }
+    if (g_project) {
+        g_project->close();
+        if (!g_quiet) {
+            std::cout << "\n";
+            for (size_t i = 0; i < g_project->cols.size(); i++)
+                std::cout << "\nProjected " << g_project->cols[i].rows
+                          << " values into " << output_dir << "/column_"
+                          << g_project->cols[i].pid << ".tsv";
+            std::cout << std::endl;
+        }
+    }
+    if (g_validate) {
+        g_validate->close();
+        std::cout << (g_quiet ? "" : "\n\n") << "Validation: "
+                  << g_validate->issues << " issues in "
+                  << g_validate->entries_flagged << " entries"
+                  << (g_validate->repair ? " (repaired)" : "") << " -> "
+                  << output_dir << "/validation_report.txt" << std::endl;
+    }
+    if (g_oversize) {
+        g_oversize->close();
+        std::cout << (g_quiet ? "" : "\n\n") << "Oversized: "
+                  << g_oversize->entries << " entries (" << g_oversize->bytes
+                  << " bytes) " << (g_oversize->skip ? "skipped" : "spilled to ")
+                  << (g_oversize->skip ? "" : output_dir + "/large_entries.json")
+                  << ", offsets in " << output_dir << "/oversize_offsets.txt"
+                  << std::endl;
+    }
+    if (g_quarantine) {
+        g_quarantine->close();
+        std::cout << (g_quiet ? "" : "\n\n") << "Quarantined "
+                  << g_quarantine->spans << " spans (" << g_quarantine->bytes
+                  << " bytes) to " << output_dir << "/quarantine.dat" << std::endl;
+    }
+    if (g_stats) {
+        std::string report = output_dir + "/split_stats.json";
+        if (g_stats->write_report(report, in.file_size, res.filtered_out)) {
+            if (!g_quiet)
+                std::cout << (g_quiet ? "" : "\n\n") << "Stats written to "
+                          << report << std::endl;
+        } else {
+            std::cerr << "Cannot write " << report << std::endl;
+        }
+    }
+    if (g_profile) {
+        std::string report = output_dir + "/split_profile.json";
+        if (g_profile->write_report(report)) {
+            if (!g_quiet)
+                std::cout << "\n\nProfile written to " << report << std::endl;
+        } else {
+            std::cerr << "Cannot write " << report << std::endl;
+        }
+    }
+    if (g_shard_fanout > 0 && !write_shard_manifest(output_dir, res.file_num))
+        std::cerr << "Cannot write " << output_dir << "/shard_manifest.json" << std::endl;
+    if (res.filtered_out > 0)
+        std::cout << (g_quiet ? "" : "\n\n") << "Kept " << res.total_entries
+                  << " of " << (res.total_entries + res.filtered_out)
+                  << " entries" << std::endl;
+    std::cout << (g_quiet || res.filtered_out > 0 ? "" : "\n\n")
+              << "Done! Total: " << res.total_entries
+              << " entries in " << res.file_num << " files" << std::endl;
     return 0;
 }